@@ -0,0 +1,433 @@
+// Fluid engine tick cost over a matrix of core sizes, neutron populations and enrichments
+// Prints a table, and with --json writes the same results for diffing between builds
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../include/core.h"
+#include "../include/coreRaster.h"
+#include "../include/fluidEngine.h"
+#include "../include/profiler.h"
+
+// Encoder and statistics calls per measurement
+#define BENCH_ENCODE_CALLS 200
+#define BENCH_STAT_CALLS 1000000
+
+typedef std::chrono::steady_clock benchClock;
+
+// neutronFluxMode names
+static const char* fluxNames[] = { "auto", "particles", "continuum" };
+
+// Options shared by every run
+struct benchOptions {
+    long ticks = 300;
+    long warmup = 60;
+    uint64_t seed = NR_DEFAULT_SEED;
+    int threads = 0;
+    float rods = 100;
+    int transportMode = TRANSPORT_FIXED_STEP;
+    int fluxMode = FLUX_AUTO;
+    float fissionSpeed = 3;
+    bool quick = false;
+    const char* jsonPath = nullptr;
+};
+
+// Mean ns per tick of each Update phase
+struct phaseTimes {
+    double transport = 0; // CollisionUpdate (movement, collision and containment) or FluxUpdate in continuum mode
+    double merge = 0; // ReactionUpdate
+    double decay = 0;
+    double heat = 0;
+    double commit = 0;
+    double stats = 0;
+};
+
+// One matrix entry and its results
+struct benchResult {
+    ReactorGeometry geometry;
+    int neutrons;
+    float enrichment;
+    int threads;
+    double nsPerTick;
+    double meanNeutrons;
+    int64_t finalNeutrons;
+    phaseTimes phases;
+    double encodeMaterial;
+    double encodeNeutrons;
+    double encodeWater;
+    double encodeRods;
+    double rasterCore; // CPU texture of the core view
+    double xenonCount;
+    double averageTemperature;
+};
+
+// ns per call of fn, over count calls
+template <typename F>
+double TimeCalls(int count, F fn)
+{
+    benchClock::time_point start = benchClock::now();
+    for (int i = 0; i < count; i++) {
+        fn();
+    }
+    return std::chrono::duration<double, std::nano>(benchClock::now() - start).count() / count;
+}
+
+// Run one matrix entry
+benchResult RunEngine(const benchOptions& options, ReactorGeometry geometry, int neutrons, float enrichment)
+{
+    benchResult result;
+    result.geometry = geometry;
+    result.neutrons = neutrons;
+    result.enrichment = enrichment;
+
+    fluidEngine* fluid = new fluidEngine();
+    fluid->settings.seed = options.seed;
+    fluid->settings.workerThreads = options.threads;
+    fluid->settings.transportMode = options.transportMode;
+    fluid->settings.fluxMode = options.fluxMode;
+    fluid->settings.fissionNeutronSpeed = options.fissionSpeed;
+    fluid->Start();
+    fluid->settings.stats.ZeroGraph();
+    fluid->SetGeometry(geometry);
+    fluid->GenerateReactor(enrichment);
+    for (int b = 0; b < fluid->RodBankCount(); b++) {
+        fluid->SetBankHeight(b, options.rods);
+    }
+    fluid->SummonNeutrons(neutrons, true);
+    for (long t = 0; t < options.warmup; t++) {
+        fluid->Update();
+    }
+
+    // Whole tick, then again with the profiler on for the phase split
+    double population = 0;
+    benchClock::time_point start = benchClock::now();
+    for (long t = 0; t < options.ticks; t++) {
+        fluid->Update();
+        population += fluid->neutronCount;
+    }
+    result.nsPerTick = std::chrono::duration<double, std::nano>(benchClock::now() - start).count() / options.ticks;
+    result.meanNeutrons = population / options.ticks;
+
+    profiler::SetEnabled(true);
+    std::vector<profileEvent> events;
+    for (long t = 0; t < options.ticks; t++) {
+        int64_t tickStart = profiler::Now();
+        fluid->Update();
+        events.clear();
+        profiler::Collect(&events, tickStart);
+        for (const profileEvent& e : events) {
+            double ns = (double)(e.end - e.start) / options.ticks;
+            if (strcmp(e.zone, "CollisionUpdate") == 0 || strcmp(e.zone, "FluxUpdate") == 0) {
+                result.phases.transport += ns;
+            } else if (strcmp(e.zone, "ReactionUpdate") == 0) {
+                result.phases.merge += ns;
+            } else if (strcmp(e.zone, "DecayUpdate") == 0) {
+                result.phases.decay += ns;
+            } else if (strcmp(e.zone, "HeatTransferUpdate") == 0) {
+                result.phases.heat += ns;
+            } else if (strcmp(e.zone, "Commit") == 0) {
+                result.phases.commit += ns;
+            } else if (strcmp(e.zone, "Statistics") == 0) {
+                result.phases.stats += ns;
+            }
+        }
+    }
+    profiler::SetEnabled(false);
+    result.finalNeutrons = fluid->neutronCount;
+    result.threads = fluid->GetThreadCount();
+
+    // Encoders into warm buffers, as the simulation thread does every frame
+    RenderSnapshot frame;
+    result.encodeMaterial = TimeCalls(BENCH_ENCODE_CALLS, [&] { fluid->LinkReactorMaterialToMain(&frame.reactorMaterial); });
+    result.encodeNeutrons = TimeCalls(BENCH_ENCODE_CALLS, [&] { fluid->LinkNeutronsToMain(&frame.neutrons); });
+    result.encodeWater = TimeCalls(BENCH_ENCODE_CALLS, [&] { fluid->LinkReactorWaterToMain(&frame.reactorWater); });
+    result.encodeRods = TimeCalls(BENCH_ENCODE_CALLS, [&] { fluid->LinkReactorRodToMain(&frame.reactorRod); });
+    frame.sizeX = geometry.sizeX;
+    frame.sizeY = geometry.sizeY;
+    coreRaster raster;
+    int cellPixels = coreRaster::CellPixels(geometry.sizeX, geometry.sizeY);
+    result.rasterCore = TimeCalls(BENCH_ENCODE_CALLS / 10, [&] { raster.Draw(frame, cellPixels); });
+
+    // Statistic sources
+    volatile double sink = 0;
+    result.xenonCount = TimeCalls(BENCH_ENCODE_CALLS, [&] { sink = sink + fluid->GetXenonCount(); });
+    result.averageTemperature = TimeCalls(BENCH_ENCODE_CALLS, [&] { sink = sink + fluid->AverageReactorTemperature(); });
+
+    delete fluid;
+    return result;
+}
+
+// Snapshot encoding cost against atoms changed per frame
+struct encodeResult {
+    ReactorGeometry geometry;
+    int changes;
+    double full; // ns, every atom and rod re-encoded
+    double incremental; // ns, journaled atoms and moved rods only
+    double water; // ns, recolour only (temperatures change everywhere)
+};
+
+encodeResult RunEncoding(const benchOptions& options, ReactorGeometry geometry, int changes)
+{
+    encodeResult result;
+    result.geometry = geometry;
+    result.changes = changes;
+
+    fluidEngine* fluid = new fluidEngine();
+    fluid->settings.seed = options.seed;
+    fluid->SetGeometry(geometry);
+    fluid->GenerateReactor(NR_ENRICHMENT);
+    RenderSnapshot frame;
+    fluid->LinkReactorMaterialChanges(&frame);
+    fluid->LinkReactorWaterChanges(&frame);
+    fluid->LinkReactorRodChanges(&frame);
+    frame.sizeX = geometry.sizeX;
+    frame.sizeY = geometry.sizeY;
+
+    result.full = TimeCalls(BENCH_ENCODE_CALLS, [&] {
+        fluid->LinkReactorMaterialToMain(&frame.reactorMaterial);
+        fluid->LinkReactorRodToMain(&frame.reactorRod);
+    });
+
+    // Flip changes atoms between frames, timing only the encode
+    rngStream rng(options.seed, 99);
+    int atoms = geometry.Cells();
+    double total = 0;
+    for (int call = 0; call < BENCH_ENCODE_CALLS; call++) {
+        for (int c = 0; c < changes; c++) {
+            int j = rng.RangeInt(0, atoms - 1);
+            fluid->SetElement(j, (call + c) % 2);
+        }
+        benchClock::time_point start = benchClock::now();
+        fluid->LinkReactorMaterialChanges(&frame);
+        fluid->LinkReactorRodChanges(&frame);
+        total += std::chrono::duration<double, std::nano>(benchClock::now() - start).count();
+    }
+    result.incremental = total / BENCH_ENCODE_CALLS;
+    result.water = TimeCalls(BENCH_ENCODE_CALLS, [&] { fluid->LinkReactorWaterChanges(&frame); });
+
+    delete fluid;
+    return result;
+}
+
+// ReactorStatistics push and read costs
+struct statResult {
+    int history;
+    double push;
+    double view;
+};
+
+statResult RunStatistics(int history)
+{
+    statResult result;
+    result.history = history;
+    ReactorStatistics stats;
+    stats.SetMax(history);
+    stats.ZeroGraph();
+
+    result.push = TimeCalls(BENCH_STAT_CALLS, [&] {
+        stats.AddReactionData(1);
+        stats.AddXenonData(2);
+        stats.AddTempData(3);
+    }) / 3;
+
+    // Walk all three histories, as the plot does every frame
+    volatile double sink = 0;
+    int walks = BENCH_STAT_CALLS / history + 1;
+    result.view = TimeCalls(walks, [&] {
+        statView<int64_t> reactivity = stats.GetReactivityStats();
+        statView<int> xenon = stats.GetXenonStats();
+        statView<float> temperature = stats.GetTempStats();
+        double sum = 0;
+        for (int i = 0; i < reactivity.Count(); i++) {
+            sum += reactivity.At(i) + xenon.At(i) + temperature.At(i);
+        }
+        sink = sink + sum;
+    }) / (3.0 * history);
+    return result;
+}
+
+// Write results as JSON
+bool WriteJson(const char* path, const benchOptions& options, const std::vector<benchResult>& results, const std::vector<encodeResult>& encodes, const std::vector<statResult>& stats)
+{
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+    fprintf(file, "{\n");
+    fprintf(file, "  \"version\": \"%s\",\n", NE_VERSION);
+    fprintf(file, "  \"seed\": %llu,\n", (unsigned long long)options.seed);
+    fprintf(file, "  \"ticks\": %ld,\n", options.ticks);
+    fprintf(file, "  \"warmup\": %ld,\n", options.warmup);
+    fprintf(file, "  \"rods\": %g,\n", options.rods);
+    fprintf(file, "  \"transport\": \"%s\",\n", options.transportMode == TRANSPORT_TRAVERSAL ? "dda" : "step");
+    fprintf(file, "  \"flux\": \"%s\",\n", fluxNames[options.fluxMode]);
+    fprintf(file, "  \"fissionSpeed\": %g,\n", options.fissionSpeed);
+    fprintf(file, "  \"engine\": [\n");
+    for (int i = 0; i < results.size(); i++) {
+        const benchResult& r = results[i];
+        fprintf(file, "    {\n");
+        fprintf(file, "      \"size\": \"%dx%d\",\n", r.geometry.sizeX, r.geometry.sizeY);
+        fprintf(file, "      \"neutrons\": %d,\n", r.neutrons);
+        fprintf(file, "      \"enrichment\": %g,\n", r.enrichment);
+        fprintf(file, "      \"threads\": %d,\n", r.threads);
+        fprintf(file, "      \"ns_per_tick\": %.1f,\n", r.nsPerTick);
+        fprintf(file, "      \"mean_neutrons\": %.1f,\n", r.meanNeutrons);
+        fprintf(file, "      \"final_neutrons\": %lld,\n", (long long)r.finalNeutrons);
+        fprintf(file, "      \"phases_ns\": { \"transport\": %.1f, \"merge\": %.1f, \"decay\": %.1f, \"heat\": %.1f, \"commit\": %.1f, \"stats\": %.1f },\n",
+            r.phases.transport, r.phases.merge, r.phases.decay, r.phases.heat, r.phases.commit, r.phases.stats);
+        fprintf(file, "      \"encoders_ns\": { \"material\": %.1f, \"neutrons\": %.1f, \"water\": %.1f, \"rods\": %.1f, \"raster\": %.1f },\n",
+            r.encodeMaterial, r.encodeNeutrons, r.encodeWater, r.encodeRods, r.rasterCore);
+        fprintf(file, "      \"stat_sources_ns\": { \"xenon_count\": %.1f, \"average_temperature\": %.1f }\n",
+            r.xenonCount, r.averageTemperature);
+        fprintf(file, "    }%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ],\n");
+    fprintf(file, "  \"encoding\": [\n");
+    for (int i = 0; i < encodes.size(); i++) {
+        const encodeResult& e = encodes[i];
+        fprintf(file, "    { \"size\": \"%dx%d\", \"changes\": %d, \"full_ns\": %.1f, \"incremental_ns\": %.1f, \"water_ns\": %.1f }%s\n",
+            e.geometry.sizeX, e.geometry.sizeY, e.changes, e.full, e.incremental, e.water, i + 1 < encodes.size() ? "," : "");
+    }
+    fprintf(file, "  ],\n");
+    fprintf(file, "  \"statistics\": [\n");
+    for (int i = 0; i < stats.size(); i++) {
+        fprintf(file, "    { \"history\": %d, \"push_ns\": %.2f, \"view_ns_per_sample\": %.2f }%s\n",
+            stats[i].history, stats[i].push, stats[i].view, i + 1 < stats.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n");
+    fprintf(file, "}\n");
+    fclose(file);
+    return true;
+}
+
+// Print usage
+void PrintHelp()
+{
+    printf("Usage: EngineBenchmark [options]\n");
+    printf("  --ticks N      Measured ticks per run (default 300)\n");
+    printf("  --warmup N     Unmeasured ticks before each run (default 60)\n");
+    printf("  --seed N       Random seed (default %d)\n", NR_DEFAULT_SEED);
+    printf("  --threads N    Neutron transport threads (default 0 = all cores)\n");
+    printf("  --rods F       Movable control rod insertion 1-100 (default 100)\n");
+    printf("  --transport M  step or dda (default step)\n");
+    printf("  --flux M       auto, particles or continuum (default auto)\n");
+    printf("  --speed F      Thermal neutron speed (default 3)\n");
+    printf("  --quick        Default core size only\n");
+    printf("  --json FILE    Also write results as JSON\n");
+}
+
+int main(int argc, char* args[])
+{
+    benchOptions options;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = args[i];
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            PrintHelp();
+            return 0;
+        }
+        if (strcmp(arg, "--quick") == 0) {
+            options.quick = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            printf("Missing value for %s\n", arg);
+            return 1;
+        }
+        const char* value = args[++i];
+        if (strcmp(arg, "--ticks") == 0) {
+            options.ticks = atol(value);
+        } else if (strcmp(arg, "--warmup") == 0) {
+            options.warmup = atol(value);
+        } else if (strcmp(arg, "--seed") == 0) {
+            options.seed = strtoull(value, nullptr, 10);
+        } else if (strcmp(arg, "--threads") == 0) {
+            options.threads = atoi(value);
+        } else if (strcmp(arg, "--rods") == 0) {
+            options.rods = atof(value);
+        } else if (strcmp(arg, "--transport") == 0) {
+            options.transportMode = strcmp(value, "dda") == 0 ? TRANSPORT_TRAVERSAL : TRANSPORT_FIXED_STEP;
+        } else if (strcmp(arg, "--flux") == 0) {
+            for (int m = 0; m < 3; m++) {
+                if (strcmp(value, fluxNames[m]) == 0) {
+                    options.fluxMode = m;
+                }
+            }
+        } else if (strcmp(arg, "--speed") == 0) {
+            options.fissionSpeed = atof(value);
+        } else if (strcmp(arg, "--json") == 0) {
+            options.jsonPath = value;
+        } else {
+            printf("Unknown option %s\n", arg);
+            PrintHelp();
+            return 1;
+        }
+    }
+    if (options.ticks < 1) {
+        options.ticks = 1;
+    }
+
+    // Matrix
+    std::vector<ReactorGeometry> geometries = { ReactorGeometry(NR_DEFAULT_SIZE_X, NR_DEFAULT_SIZE_Y) };
+    if (!options.quick) {
+        geometries.push_back(ReactorGeometry(NR_DEFAULT_SIZE_X * 2, NR_DEFAULT_SIZE_Y * 2));
+        geometries.push_back(ReactorGeometry(NR_DEFAULT_SIZE_X * 4, NR_DEFAULT_SIZE_Y * 4));
+    }
+    const int populations[] = { 10, 500, 5000 };
+    const float enrichments[] = { 0.05f, NR_ENRICHMENT };
+
+    std::vector<benchResult> results;
+    printf("%-9s %-8s %-6s %-11s %-9s %-10s %-9s %-9s %-9s %-9s %-9s %-11s %-11s %-11s\n",
+        "size", "neutrons", "enrich", "ns/tick", "mean n", "transport", "merge", "decay", "heat", "commit", "stats", "enc mat", "enc water", "raster");
+    for (const ReactorGeometry& geometry : geometries) {
+        for (int population : populations) {
+            for (float enrichment : enrichments) {
+                benchResult r = RunEngine(options, geometry, population, enrichment);
+                results.push_back(r);
+                char size[32];
+                snprintf(size, sizeof(size), "%dx%d", geometry.sizeX, geometry.sizeY);
+                printf("%-9s %-8d %-6g %-11.0f %-9.0f %-10.0f %-9.0f %-9.0f %-9.0f %-9.0f %-9.0f %-11.0f %-11.0f %-11.0f\n",
+                    size, population, enrichment, r.nsPerTick, r.meanNeutrons, r.phases.transport, r.phases.merge,
+                    r.phases.decay, r.phases.heat, r.phases.commit, r.phases.stats, r.encodeMaterial, r.encodeWater, r.rasterCore);
+            }
+        }
+    }
+
+    std::vector<encodeResult> encodes;
+    printf("\n%-9s %-8s %-11s %-14s %-11s\n", "size", "changes", "full ns", "incremental", "water ns");
+    std::vector<ReactorGeometry> encodeGeometries = { ReactorGeometry() };
+    if (!options.quick) {
+        encodeGeometries.push_back(ReactorGeometry(NR_DEFAULT_SIZE_X * 4, NR_DEFAULT_SIZE_Y * 4));
+        encodeGeometries.push_back(ReactorGeometry(NR_DEFAULT_SIZE_X * 16, NR_DEFAULT_SIZE_Y * 16));
+    }
+    for (const ReactorGeometry& geometry : encodeGeometries) {
+        for (int changes : { 0, 16, 256, 2048 }) {
+            encodeResult e = RunEncoding(options, geometry, changes);
+            encodes.push_back(e);
+            char size[32];
+            snprintf(size, sizeof(size), "%dx%d", geometry.sizeX, geometry.sizeY);
+            printf("%-9s %-8d %-11.0f %-14.0f %-11.0f\n", size, changes, e.full, e.incremental, e.water);
+        }
+    }
+
+    std::vector<statResult> stats;
+    printf("\n%-9s %-10s %-14s\n", "history", "push ns", "view ns/sample");
+    for (int history : { 60, 600, 6000 }) {
+        statResult s = RunStatistics(history);
+        stats.push_back(s);
+        printf("%-9d %-10.2f %-14.2f\n", s.history, s.push, s.view);
+    }
+
+    if (options.jsonPath != nullptr) {
+        if (!WriteJson(options.jsonPath, options, results, encodes, stats)) {
+            printf("Could not write %s\n", options.jsonPath);
+            return 1;
+        }
+        printf("\nWrote %s\n", options.jsonPath);
+    }
+    return 0;
+}
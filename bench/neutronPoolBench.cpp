@@ -0,0 +1,110 @@
+// Neutron storage throughput: legacy std::vector<neutron> vs neutronPool
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../include/neutronPool.h"
+
+#define BENCH_TICKS 50
+#define BENCH_KILL_CHANCE 0.02
+#define BENCH_DELTATIME (1.0 / 60)
+
+// Old array-of-structs neutron
+class legacyNeutron {
+public:
+    double posX, posY, velX, velY;
+    int id;
+    bool fast;
+    legacyNeutron(double x, double y, int newid, bool fastNeutron)
+    {
+        posX = x;
+        posY = y;
+        velX = 1;
+        velY = 1;
+        id = newid;
+        fast = fastNeutron;
+    }
+};
+
+// Old removal path, linear id scan and erase
+void LegacyDestroy(std::vector<legacyNeutron>* neutrons, int id)
+{
+    for (int i = 0; i < neutrons->size(); i++) {
+        if ((*neutrons)[i].id == id) {
+            neutrons->erase(neutrons->begin() + i);
+            break;
+        }
+    }
+}
+
+double RunLegacy(int count)
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::vector<legacyNeutron> neutrons;
+    int nextID = 0;
+    for (int i = 0; i < count; i++) {
+        neutrons.push_back(legacyNeutron(uniform(rng), uniform(rng), nextID++, true));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < BENCH_TICKS; t++) {
+        int births = 0;
+        for (int i = 0; i < neutrons.size(); i++) {
+            if (uniform(rng) < BENCH_KILL_CHANCE) {
+                LegacyDestroy(&neutrons, neutrons[i].id);
+                births++;
+                continue;
+            }
+            neutrons[i].posX += neutrons[i].velX * BENCH_DELTATIME;
+            neutrons[i].posY += neutrons[i].velY * BENCH_DELTATIME;
+        }
+        for (int i = 0; i < births; i++) {
+            neutrons.push_back(legacyNeutron(uniform(rng), uniform(rng), nextID++, true));
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+double RunPool(int count)
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    neutronPool neutrons;
+    for (int i = 0; i < count; i++) {
+        neutrons.Spawn(uniform(rng), uniform(rng), 1, 1, true);
+    }
+    neutrons.Commit();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < BENCH_TICKS; t++) {
+        for (int i = 0; i < neutrons.Size(); i++) {
+            if (uniform(rng) < BENCH_KILL_CHANCE) {
+                neutrons.Kill(i);
+                neutrons.Spawn(uniform(rng), uniform(rng), 1, 1, true);
+                continue;
+            }
+            neutrons.posX[i] += neutrons.velX[i] * BENCH_DELTATIME;
+            neutrons.posY[i] += neutrons.velY[i] * BENCH_DELTATIME;
+        }
+        neutrons.Commit();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+int main()
+{
+    const int sizes[] = { 10000, 100000 };
+    printf("%-10s %-14s %-14s %-14s %-14s\n", "neutrons", "legacy ms/tick", "pool ms/tick", "legacy ns/n", "pool ns/n");
+    for (int count : sizes) {
+        double legacy = RunLegacy(count) / BENCH_TICKS;
+        double pool = RunPool(count) / BENCH_TICKS;
+        printf("%-10d %-14.3f %-14.3f %-14.1f %-14.1f\n", count, legacy * 1e3, pool * 1e3,
+            legacy * 1e9 / count, pool * 1e9 / count);
+    }
+    return 0;
+}
@@ -0,0 +1,54 @@
+// Water grid stencil throughput (cell updates per second)
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "../include/waterGrid.h"
+#include "../include/workerPool.h"
+
+// Minimum time per measurement
+#define BENCH_MIN_SECONDS 0.25
+
+// Time steps of one grid size with one kernel
+double RunGrid(int w, int h, waterKernel kernel, workerPool* workers)
+{
+    waterGrid grid;
+    grid.Resize(w, h);
+    grid.SetKernel(kernel);
+    std::vector<float> heat(w * h, 0.25f);
+    for (int i = 0; i < grid.Size(); i++) {
+        grid.Temperatures()[i] = (i % 97);
+    }
+    grid.Refresh();
+
+    long steps = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed(0);
+    while (elapsed.count() < BENCH_MIN_SECONDS) {
+        grid.Step(heat.data(), 0.1f, 0.5f, 20, workers);
+        steps++;
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    return (double)steps * w * h / elapsed.count();
+}
+
+int main(int argc, char* args[])
+{
+    const int sizes[][2] = { { 40, 25 }, { 256, 256 }, { 1024, 1024 }, { 4096, 4096 } };
+    workerPool workers;
+    workers.Start(0);
+
+    printf("AVX2 available: %s\n", waterGrid::HasAVX2() ? "yes" : "no");
+    printf("Threads: %d\n", workers.ThreadCount());
+    printf("%-12s %-16s %-16s %-16s\n", "grid", "scalar Mcell/s", "auto Mcell/s", "auto MT Mcell/s");
+    for (const int* size : sizes) {
+        double scalar = RunGrid(size[0], size[1], WATER_KERNEL_SCALAR, nullptr);
+        double simd = RunGrid(size[0], size[1], WATER_KERNEL_AUTO, nullptr);
+        double threaded = RunGrid(size[0], size[1], WATER_KERNEL_AUTO, &workers);
+        char name[32];
+        snprintf(name, sizeof(name), "%dx%d", size[0], size[1]);
+        printf("%-12s %-16.1f %-16.1f %-16.1f\n", name, scalar / 1e6, simd / 1e6, threaded / 1e6);
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+
+// Reactor checkpoint file layout
+// Header, section table, then each section's raw arrays (native byte order, 8-byte aligned)
+// so a mapped file can be copied straight into the engine
+#define NR_CHECKPOINT_MAGIC "NIPCKPT"
+#define NR_CHECKPOINT_VERSION 3 // 2: neutrons may be weighted packets or held by CHECKPOINT_FLUX, state is 272 bytes
+                                // 3: neutron history in CHECKPOINT_STATS is int64
+#define NR_CHECKPOINT_VERSION_MIN 1 // Oldest version read (1 loads as unweighted particles)
+#define NR_CHECKPOINT_ALIGN 8
+
+enum checkpointSectionId : uint32_t {
+    CHECKPOINT_STATE = 1, // checkpointState
+    CHECKPOINT_ATOMS, // int32 x[n], int32 y[n], uint8 element[n]
+    CHECKPOINT_WATER, // float temperature[sizeX * sizeY]
+    CHECKPOINT_NEUTRONS, // double x[n], y[n], vx[n], vy[n], uint8 fast[n]
+    CHECKPOINT_RODS, // checkpointRod[n]
+    CHECKPOINT_STATS, // int64 reactivity[n] (int32 before version 3), int32 xenon[n], float temperature[n] (oldest first)
+    CHECKPOINT_ELEMENT_ORDER, // int32 atom[n], inert then U-235 then xenon atoms in elementIndex order (optional)
+    CHECKPOINT_ROD_BANKS, // int32 bank[n] per rod, -1 = not driven (optional, older files deal movable rods as GenerateReactor)
+    CHECKPOINT_NEUTRON_WEIGHTS, // double weight[n] per neutron packet (version 2, version 1 loads weights of 1)
+    CHECKPOINT_FLUX, // float fast[n], float thermal[n], n = sizeX * sizeY in continuum mode, 0 otherwise (version 2)
+    CHECKPOINT_BANK_HEIGHTS, // float height[n] per rod bank (optional, older files keep the first five in checkpointState)
+    CHECKPOINT_SECTION_COUNT = 11
+};
+
+struct checkpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t sectionCount;
+};
+
+struct checkpointSection {
+    uint32_t id;
+    uint32_t reserved;
+    uint64_t count; // Elements
+    uint64_t offset; // Bytes from start of file
+    uint64_t size; // Bytes
+};
+
+// Everything that is not an array
+struct checkpointState {
+    uint64_t rng[5][4]; // Core, transport, decay, heat, user
+    uint64_t seed;
+    int64_t tickCount;
+    int32_t sizeX;
+    int32_t sizeY;
+    int32_t statUpdate;
+    int32_t fissionNeutronCount;
+    float fissionNeutronSpeed;
+    float fissionFastNeutronSpeed;
+    float decayChance;
+    float waterAbsorptionChance;
+    float xenonDecayChance;
+    float heatDissipate;
+    float waterFlow;
+    float heatTransfer;
+    float rodHeight[5]; // Settings of the first five rod banks (every bank is in CHECKPOINT_BANK_HEIGHTS)
+    int32_t transportMode; // neutronTransportMode (0 in older files)
+    // Version 2 (version 1 files end here, the rest loads as 0)
+    int32_t weightedNeutrons; // Weighted transport on
+    int32_t neutronPackets; // Packet target (0 = keep current)
+    int32_t fluxMode; // neutronFluxMode (0 = FLUX_AUTO)
+    int32_t continuumAbove; // Flux mode bounds (0 = keep current)
+    int32_t continuumBelow;
+    int32_t reserved;
+};
+
+struct checkpointRod {
+    float xPosition;
+    float height;
+    uint32_t moderator;
+};
+
+static_assert(sizeof(checkpointHeader) == 16, "checkpoint header layout");
+static_assert(sizeof(checkpointSection) == 32, "checkpoint section layout");
+static_assert(sizeof(checkpointState) == 272, "checkpoint state layout");
+#define NR_CHECKPOINT_STATE_MIN 248 // State size of version 1
+static_assert(sizeof(checkpointRod) == 12, "checkpoint rod layout");
@@ -5,14 +5,35 @@
 #define NE_TARGET_TICKRATE 60
 #define NE_TICKRATE_TIME (1000 / NE_TARGET_TICKRATE)
 #define NE_DELTATIME (1.0 / NE_TARGET_TICKRATE)
+#define NE_TRANSPORT_CHUNK 1024
+#define NE_MAX_CATCHUP_TICKS 64
+#define NE_CHANGE_JOURNAL 4096 // Atom changes kept for incremental snapshot encoding
+#define NE_PACKET_MAX_SPLIT 64 // Most packets one spawned neutron is split into (weighted transport)
+#define NE_PACKET_ROULETTE 0.5 // Packets lighter than this share of the packet weight play Russian roulette
+#define NE_PACKET_SPLIT 2 // Packets heavier than this many packet weights are split again (at most NE_PACKET_MAX_SPLIT ways)
+#define NE_PACKET_SPLIT_TURN 0.5 // Largest turn (radians) of a split packet's children off its direction
 // Nuclear Reactor Structure Config
-#define NR_SIZE_X 40
-#define NR_SIZE_Y 25
+#define NR_DEFAULT_SIZE_X 40
+#define NR_DEFAULT_SIZE_Y 25
+#define NR_ROD_SPACING 4
+#define NR_ROD_BANKS 5 // Banks the generated core's movable rods are dealt into
+#define NR_MAX_ROD_BANKS 32
 #define NR_ENRICHMENT 0.2
+#define NR_DEFAULT_SEED 1
 #define NR_WATER_RANGE 1.5
 #define NR_WATER_TEMP_OFFSET 20
+#define NR_FLUX_FLIGHT 4 // Mean straight flight of a neutron in cells, turns neutron speed into the continuum diffusion rate
+#define NR_FLUX_CEILING 1e18 // Most neutrons the flux field holds (keeps float cells finite and counts inside int64_t)
+#define NR_STAT_SLACK 4 // Stat ring capacity as a multiple of history
+#define NR_CHECKPOINT_PATH "reactor.nipc"
+#define NR_TELEMETRY_PATH "telemetry"
 // Reactor Renderer
 #define RR_SCALE 30
 #define RR_ATOM_PADDING 5
 #define RR_WATER_PADDING 0.1
-#define RR_CR_PADDING 4
\ No newline at end of file
+#define RR_CR_PADDING 4
+#define RR_PROFILE_HISTORY 300
+#define RR_RASTER_MIN_CELLS 4096 // Larger cores are drawn as one texture instead of per-cell primitives
+#define RR_RASTER_CELL 4 // Most texels per cell side
+#define RR_RASTER_MAX_PIXELS (4 * 1024 * 1024)
+#define RR_RASTER_VIEW 1200 // Longest side of the textured core view in screen pixels
\ No newline at end of file
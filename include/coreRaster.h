@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "reactorData.h"
+
+// CPU rasterizer for the core view
+// Draws a render snapshot into an RGBA pixel buffer (a small block per lattice cell) so the whole core
+// is a single texture upload, instead of one ImGui primitive per water cell, atom, neutron and rod
+class coreRaster {
+public:
+    // Texels per cell side for a core, keeping the texture under RR_RASTER_MAX_PIXELS
+    static int CellPixels(int sizeX, int sizeY);
+
+    // Redraw from frame at cellPixels texels per cell (same colours and layering as the primitive view)
+    void Draw(const RenderSnapshot& frame, int cellPixels);
+
+    // Row-major RGBA8, top row first
+    const uint32_t* Pixels() const { return pixels.data(); };
+    int Width() const { return width; };
+    int Height() const { return height; };
+
+private:
+    // Fill texels whose centres lie inside the rectangle (primitive view coordinates)
+    // Non-empty sides thinner than minSize texels are widened around their centre
+    void FillRect(float x0, float y0, float x1, float y1, uint32_t colour, float minSize);
+
+    std::vector<uint32_t> pixels;
+    int width = 0;
+    int height = 0;
+    float scale = 1; // Texels per primitive view pixel
+};
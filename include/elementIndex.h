@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+
+// Atom elements (0 = Inert, 1 = U-235, 2 = Xe-135)
+#define NR_ELEMENT_COUNT 3
+
+// Atoms grouped by element, each group indexable for constant-time counts and random picks
+// A change of element swaps the atom with the last member of its old group, so every update is O(1)
+class elementIndex {
+public:
+    void Clear()
+    {
+        for (int e = 0; e < NR_ELEMENT_COUNT; e++) {
+            members[e].clear();
+        }
+        slot.clear();
+    };
+
+    // Track a newly appended atom (atoms are numbered in the order they are added)
+    inline void Add(int atom, int element)
+    {
+        slot.resize(atom + 1);
+        slot[atom] = members[element].size();
+        members[element].push_back(atom);
+    };
+
+    // Move atom between groups
+    inline void Move(int atom, int from, int to)
+    {
+        int last = members[from].back();
+        members[from][slot[atom]] = last;
+        slot[last] = slot[atom];
+        members[from].pop_back();
+        slot[atom] = members[to].size();
+        members[to].push_back(atom);
+    };
+
+    int Count(int element) const { return members[element].size(); };
+    // Group members in order (the order random picks see, so checkpoints keep it)
+    const std::vector<int>& Members(int element) const { return members[element]; };
+
+    // Put a group's members in the given order (must be the same atoms)
+    inline void Reorder(int element, const int* atoms)
+    {
+        for (int k = 0; k < members[element].size(); k++) {
+            members[element][k] = atoms[k];
+            slot[atoms[k]] = k;
+        }
+    };
+    // k-th atom of element (any order)
+    int At(int element, int k) const { return members[element][k]; };
+
+private:
+    std::vector<int> members[NR_ELEMENT_COUNT];
+    std::vector<int> slot; // Atom -> position in its group
+};
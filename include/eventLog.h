@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spscQueue.h"
+
+#define NR_EVENT_MAGIC "NIPEVT1"
+#define NR_EVENT_VERSION 1
+#define NR_EVENT_BATCH 65536 // Records per batch handed to the writer
+#define NR_EVENT_MAX_COORD 16383 // 14 bits per axis
+
+enum eventType {
+    EVENT_FISSION = 0,
+    EVENT_XENON_ABSORPTION,
+    EVENT_ROD_ABSORPTION,
+    EVENT_WATER_ABSORPTION,
+    EVENT_ESCAPE,
+    EVENT_TYPE_COUNT
+};
+
+// One event, 8 bytes
+// packed: x (14 bits) | y (14 bits) << 14 | type (3 bits) << 28 | fast (1 bit) << 31
+struct eventRecord {
+    uint32_t tick;
+    uint32_t packed;
+
+    inline int X() const { return packed & NR_EVENT_MAX_COORD; };
+    inline int Y() const { return (packed >> 14) & NR_EVENT_MAX_COORD; };
+    inline int Type() const { return (packed >> 28) & 7; };
+    inline bool Fast() const { return (packed >> 31) != 0; };
+};
+
+// File header, followed by eventRecord[] until end of file
+struct eventLogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    int32_t sizeX;
+    int32_t sizeY;
+};
+
+static_assert(sizeof(eventRecord) == 8, "event record layout");
+static_assert(sizeof(eventLogHeader) == 24, "event log header layout");
+
+// Append-only event stream
+// The simulation thread fills a batch in memory, full batches are written on a background thread
+class eventLog {
+public:
+    eventLog() { };
+    ~eventLog() { Close(); };
+
+    bool Open(const std::string& path, int sizeX, int sizeY);
+    // Write everything recorded so far and stop writer
+    void Close();
+    bool IsOpen() const { return running.load(std::memory_order_acquire); };
+
+    // Record event at cell (simulation thread only, coordinates are clamped into the core)
+    inline void Record(eventType type, uint32_t tick, int x, int y, bool fast)
+    {
+        x = x < 0 ? 0 : (x >= width ? width - 1 : x);
+        y = y < 0 ? 0 : (y >= height ? height - 1 : y);
+        eventRecord e;
+        e.tick = tick;
+        e.packed = (uint32_t)x | ((uint32_t)y << 14) | ((uint32_t)type << 28) | ((uint32_t)fast << 31);
+        batch->push_back(e);
+        if (batch->size() >= NR_EVENT_BATCH) {
+            Submit();
+        }
+    };
+
+    long long Written() const { return written.load(std::memory_order_relaxed); };
+
+private:
+    void Submit();
+    void WriterLoop();
+
+    // Full batches to the writer, empty ones back
+    spscQueue<std::vector<eventRecord>*> full { 64 };
+    spscQueue<std::vector<eventRecord>*> empty { 64 };
+    std::vector<eventRecord>* batch = nullptr;
+    std::thread writer;
+    std::atomic<bool> running { false };
+    std::atomic<long long> written { 0 };
+    FILE* file = nullptr;
+    int width = 1;
+    int height = 1;
+};
@@ -1,44 +1,31 @@
 #pragma once
 #include <VectorMath.h>
 
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
-
+#include <atomic>
 #include <cmath>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
-#include "renderEngine.h"
-
-class neutron {
-public:
-    VM::Vector2 position = VM::Vector2(0, 0);
-    VM::Vector2 velocity = VM::Vector2(0, 0);
-    int id;
-    bool fast;
-    neutron(double x, double y, int newid, bool fastNeutron)
-    {
-        position = VM::Vector2(x, y);
-        id = newid;
-        fast = fastNeutron;
-    }
-};
-
-class water {
-public:
-    VM::Vector2Int position = VM::Vector2Int(0, 0);
-    float temperature;
-    water(int x, int y, float temp = 0)
-    {
-        position = VM::Vector2Int(x, y);
-        temperature = temp;
-    }
-};
+#include "neutronPool.h"
+#include "core.h"
+#include "elementIndex.h"
+#include "eventLog.h"
+#include "fluxGrid.h"
+#include "reactorData.h"
+#include "reactorGeometry.h"
+#include "rodTable.h"
+#include "rngStream.h"
+#include "telemetry.h"
+#include "tripleBuffer.h"
+#include "waterGrid.h"
+#include "workerPool.h"
 
 class atom {
 public:
     VM::Vector2Int position = VM::Vector2Int(0, 0);
-    int element = 0; // 0 = Inert, 1 = U-235
+    int element = 0; // 0 = Inert, 1 = U-235, 2 = Xe-135
     atom(int x, int y, int e)
     {
         position = VM::Vector2Int(x, y);
@@ -54,18 +41,19 @@ public:
     };
 };
 
-class controlRod {
-public:
-    float xPosition;
-    float height;
-    bool moderator;
+// Thermal neutron inside an atom's radius (resolved after transport)
+struct neutronContact {
+    int neutron;
+    int atom;
+};
 
-    controlRod(float x, float insertion, bool mod)
-    {
-        xPosition = x;
-        height = insertion;
-        moderator = mod;
-    }
+// Per-chunk transport output, merged in chunk order
+class transportBuffer {
+public:
+    std::vector<neutronContact> contacts;
+    std::vector<int> kills; // Rod absorptions
+    std::vector<int> escapes; // Left the core
+    double moderated = 0; // Weight of fast neutrons turned thermal
 };
 
 class fluidEngine {
@@ -73,45 +61,167 @@ public:
     // Standard
     fluidEngine();
     ~fluidEngine();
-    void Start(renderEngine* ren);
+    void Start();
     void Update();
+    // Persistent simulation thread (fixed timestep, decoupled from rendering)
+    void StartSimulation();
+    void StopSimulation();
+    void SetGeometry(ReactorGeometry newGeometry);
+    void GenerateReactor(float enrichment);
     // Reactor Alterations
     void AddReactorMaterial(int x, int y, int element);
-    void AddControlRod(int x, int h, bool moderator);
-    void SetControlRodHeight(int id, int h);
+    void AddControlRod(float x, float h, bool moderator, int bank = -1);
+    void SetControlRodHeight(int id, float h);
+    // Rod banks (simulation thread, or before it starts; the UI asks through RequestBankHeights)
+    void SetBankHeight(int bank, float h);
+    float BankHeight(int bank);
+    int RodBankCount() { return rodBanks.size(); };
+    void SetElement(int j, int element);
     void AddNeutron(int x, int y, bool fast);
+    void SummonNeutrons(int count, bool fast);
     void AddWater(int x, int y);
-    void DestroyNeutron(int id);
+    void DestroyNeutron(int i);
     void ClearNeutrons();
+    int ControlRodCount() { return controlRods.size(); };
+    // Thread-safe requests (applied at the start of the next tick)
+    void RequestNeutrons(int count);
+    void RequestClearNeutrons();
+    void RequestSave(const std::string& path);
+    void RequestLoad(const std::string& path);
+    // Insertion of the first banks, dropped unless version is the snapshot bankVersion they were based on
+    void RequestBankHeights(const float* heights, int banks, uint64_t version);
+    // Checkpoints (whole reactor state, call between ticks)
+    bool SaveCheckpoint(const char* path);
+    bool LoadCheckpoint(const char* path);
     // Engine -> Renderer Linkage
     void LinkReactorMaterialToMain(std::vector<CircleData>* newPositions);
     void LinkReactorRodToMain(std::vector<RectangleData>* newPositions);
     void LinkNeutronsToMain(std::vector<CircleData>* newPositions);
     void LinkReactorWaterToMain(std::vector<RectangleData>* newPositions);
+    // Incremental encoders, only rewrite what changed since frame was last encoded
+    void LinkReactorMaterialChanges(RenderSnapshot* frame);
+    void LinkReactorWaterChanges(RenderSnapshot* frame);
+    void LinkReactorRodChanges(RenderSnapshot* frame);
+    void PublishSnapshot();
+    tripleBuffer<RenderSnapshot> snapshots;
+    // Engine -> Telemetry (open to record every sampled tick)
+    telemetrySink telemetry;
+    // Engine -> Event log (open and close between ticks)
+    eventLog events;
     // Engine -> Sound Linkage
-    bool isPlayingSound = false;
+    std::atomic<bool> isPlayingSound { false };
     // Engine -> UI Linkage
-    int neutronCount;
+    ReactorGeometry geometry;
+    int64_t neutronCount = 0; // Physical neutrons (packet weights summed, can pass INT_MAX in a supercritical run)
+    long tickCount = 0;
     ReactorSettings settings;
+    // Reactor aggregates, maintained as the state changes so every read is O(1)
+    float AverageReactorTemperature();
+    float MaxReactorTemperature();
+    int GetElementCount(int element);
+    int GetXenonCount();
+    int64_t GetFastNeutronCount();
+    int64_t GetThermalNeutronCount();
+    int GetPacketCount();
+    bool IsContinuum() const { return continuum; };
+    // Threads transport runs on (workerThreads 0 resolved to the hardware count)
+    int GetThreadCount() const { return workers.ThreadCount(); };
 
 private:
     // Neutron Updates
-    void CollisionUpdate(neutron* particle);
-    void ContainerUpdate(neutron* particle);
-    void PositionUpdate(neutron* particle);
+    template <int SizeX, int SizeY>
+    void TransportChunk(int chunk);
+    template <int SizeX, int SizeY>
+    bool CollisionUpdate(int i, transportBuffer* buffer);
+    template <int SizeX, int SizeY>
+    bool ContainerUpdate(int i, transportBuffer* buffer);
+    template <int SizeX, int SizeY>
+    bool TraversalUpdate(int i, transportBuffer* buffer);
+    void PositionUpdate(int i);
+    void RecordNeutronEvent(eventType type, int i);
+    void ReactionUpdate(int i, int j);
+    double TakeNeutron(int i);
+    int PacketAtoms(double weight);
+    void NearestAtoms(int j, int element, int count, std::vector<int>* out);
+    void TransportUpdate();
+    // Continuum (flux field) Updates
+    void UpdateFluxMode();
+    void ToContinuum();
+    void ToParticles();
+    void FluxUpdate();
+    void FluxReactionUpdate();
+    void BuildRodEdges();
+    double Population();
+    void UpdateNeutronCount();
     // Atom (Reactor Material) Updates
-    void DecayUpdate(atom* particle);
+    void DecayUpdate();
     void RegenUpdate(atom* particle);
-    void RegenInert();
+    int RegenInert();
     // Water Updates
-    void HeatTransferUpdate(water* particle);
-    // UI Calculations
-    float AverageReactorTemperature();
-    int GetXenonCount();
+    void HeatTransferUpdate();
+    // Weighted transport
+    void UpdatePacketWeight();
+    void PopulationControl();
+    // Rods
+    void ApplyRodBanks();
+    // Telemetry
+    void RecordTelemetry();
+    // Neutron creation
+    void SpawnNeutron(double x, double y, bool fast, rngStream* rng, double weight = 1);
 
     // Reactor
     std::vector<atom> reactorMaterial;
-    std::vector<neutron> neutrons;
-    std::vector<water> reactorWater;
+    std::vector<int> materialGrid; // Lattice cell (row-major) -> reactorMaterial index (-1 = empty)
+    elementIndex atomElements; // reactorMaterial indices by element (kept in step by AddReactorMaterial and SetElement)
+    std::vector<int64_t> regenTick; // Tick each atom was last regenerated to U-235 (grown by RegenInert)
+    neutronPool neutrons;
+    double packetWeight = 1; // Weight of newly spawned packets (1 unless weighted transport is on)
+    std::vector<int> packetAtoms; // Atoms one packet reaction changes (scratch for NearestAtoms)
+    waterGrid reactorWater;
+    std::vector<float> waterHeat; // Heat deposited per water cell this tick
+    std::vector<VM::Vector2Int> waterStencil; // Cell offsets a neutron can reach within NR_WATER_RANGE
+    std::vector<float> waterReach; // Share of a cell's neutrons within NR_WATER_RANGE of each waterStencil offset
+    // Continuum mode
+    fluxGrid flux;
+    bool continuum = false; // Neutrons are held by flux instead of neutrons
+    std::vector<float> rodAbsorberEdges; // Absorbing rod faces bordering each cell (weighted by the share of the row they cover)
+    std::vector<float> rodModeratorEdges; // Moderating rod faces bordering each cell
+    uint64_t rodEdgeVersion = 0; // rodTableVersion the edges were built at
     std::vector<controlRod> controlRods;
+    std::vector<std::vector<int>> rodBanks; // controlRods indices of each bank
+    float bankHeight[NR_MAX_ROD_BANKS] = {}; // Insertion each bank was last set to
+    uint64_t bankVersion = 1; // Bumped when banks change other than by a UI request (new rods, load, SetBankHeight)
+    void MoveBank(int bank, float h);
+    rodTable rodColumns; // Built from controlRods at rodTableVersion
+    uint64_t rodTableVersion = 0;
+    // Render change tracking
+    uint64_t layoutVersion = 1; // Bumped when atoms, rods or the core size change
+    uint64_t rodVersion = 1; // Bumped whenever a rod moves
+    std::vector<int> atomChanges; // Atoms whose element changed, oldest first (may repeat)
+    uint64_t atomChangeBase = 1; // Change number of atomChanges[0]
+    // Random streams (one per subsystem so each is reproducible on its own)
+    rngStream rngCore;
+    rngStream rngTransport;
+    rngStream rngDecay;
+    rngStream rngHeat;
+    rngStream rngUser;
+    // Neutron transport workers
+    workerPool workers;
+    std::vector<transportBuffer> transportBuffers;
+    // Simulation thread
+    void SimulationLoop();
+    std::thread simulationThread;
+    std::atomic<bool> simulationRunning { false };
+    // Pending requests from other threads
+    std::atomic<int> requestedNeutrons { 0 };
+    std::atomic<bool> requestedClear { false };
+    std::mutex requestLock;
+    std::string requestedSave;
+    std::string requestedLoad;
+    float requestedBankHeight[NR_MAX_ROD_BANKS] = {};
+    int requestedBanks = 0;
+    uint64_t requestedBankVersion = 0;
+    // Tick state
+    int statUpdate = NE_TARGET_TICKRATE;
+    double fissionCount = 0; // Since last telemetry sample (fractional in continuum mode)
 };
\ No newline at end of file
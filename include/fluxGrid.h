@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+
+#include "waterGrid.h"
+#include "workerPool.h"
+
+// Two-group neutron flux on the lattice (neutrons per cell, row-major, index = x + y * width)
+// Stands in for individual neutrons in continuum mode: each step diffuses both groups,
+// removes what rods and water absorb and moves fast flux that meets a moderator into the thermal group
+class fluxGrid {
+public:
+    // Allocate width * height cells at zero
+    void Resize(int w, int h);
+    int Width() const { return width; };
+    int Height() const { return height; };
+    int Size() const { return width * height; };
+
+    // Current flux, call Refresh() after writing through the mutable pointers
+    float* Fast() { return fast.data(); };
+    float* Thermal() { return thermal.data(); };
+    const float* Fast() const { return fast.data(); };
+    const float* Thermal() const { return thermal.data(); };
+    // Add n neutrons to cell i (negative takes them away, never below zero), keeping the sums current
+    void Add(int i, bool fastGroup, float n);
+    void Clear();
+    // Multiply every cell by factor, keeping the sums current
+    void Scale(double factor);
+
+    // Neutrons in each group, reduced during Step so reads are O(1)
+    double FastSum() const { return fastSum; };
+    double ThermalSum() const { return thermalSum; };
+    double Sum() const { return fastSum + thermalSum; };
+    // Recompute sums after external writes
+    void Refresh();
+
+    // Per-cell chance this step of being absorbed (each group) or of a fast neutron being moderated
+    // Written by the caller before Step, fastRemoval + moderation must not exceed 1
+    float* FastRemoval() { return fastRemoval.data(); };
+    float* ThermalRemoval() { return thermalRemoval.data(); };
+    float* Moderation() { return moderation.data(); };
+
+    // Advance one step
+    // fastDiffusion, thermalDiffusion: share of a cell's flux passed to each neighbour (clamped for stability)
+    // fastLeak, thermalLeak: share of an edge cell's flux leaving the core through each outer face
+    void Step(float fastDiffusion, float thermalDiffusion, float fastLeak, float thermalLeak, workerPool* workers);
+
+    // Kernel selection (same choice as waterGrid, auto picks AVX2 when the CPU has it)
+    void SetKernel(waterKernel k) { kernel = k; };
+    waterKernel ActiveKernel() const;
+
+private:
+    int width = 0;
+    int height = 0;
+    std::vector<float> fast;
+    std::vector<float> thermal;
+    std::vector<float> nextFast;
+    std::vector<float> nextThermal;
+    std::vector<float> fastRemoval;
+    std::vector<float> thermalRemoval;
+    std::vector<float> moderation;
+    waterKernel kernel = WATER_KERNEL_AUTO;
+    // Aggregates of current
+    double fastSum = 0;
+    double thermalSum = 0;
+    // Per-chunk partial sums of the last Step
+    std::vector<double> chunkFast;
+    std::vector<double> chunkThermal;
+};
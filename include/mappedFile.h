@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only memory mapped file
+class mappedFile {
+public:
+    mappedFile() { };
+    ~mappedFile() { Close(); };
+    mappedFile(const mappedFile&) = delete;
+    mappedFile& operator=(const mappedFile&) = delete;
+
+    // Map whole file (returns false if missing or empty)
+    bool Open(const char* path);
+    void Close();
+
+    const uint8_t* Data() const { return data; };
+    size_t Size() const { return size; };
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#if defined(_WIN32)
+    void* file = nullptr;
+    void* mapping = nullptr;
+#endif
+};
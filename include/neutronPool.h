@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Structure-of-arrays neutron storage
+// Kills and births are deferred until Commit() so indices stay stable during a tick
+// Each entry is a packet standing for weight neutrons (always 1 unless weighted transport is on)
+class neutronPool {
+public:
+    // Live neutrons
+    std::vector<double> posX;
+    std::vector<double> posY;
+    std::vector<double> velX;
+    std::vector<double> velY;
+    std::vector<uint8_t> fast;
+    std::vector<double> weight;
+
+    // Number of live packets (including ones marked for removal this tick)
+    inline int Size() const { return posX.size(); };
+
+    // Physical neutrons (summed weight) of live packets, kept up to date by Commit/Assign/Clear, SetWeight and Moderated
+    inline double Weight() const { return totalWeight; };
+    inline double FastWeight() const { return fastWeight; };
+
+    // Account for live packets of this total weight whose fast flag was cleared in place
+    inline void Moderated(double w) { fastWeight -= w; };
+
+    // Change weight of live packet i
+    inline void SetWeight(int i, double w)
+    {
+        totalWeight += w - weight[i];
+        if (fast[i]) {
+            fastWeight += w - weight[i];
+        }
+        weight[i] = w;
+    };
+
+    // Recompute summed weights in packet order (drops rounding drift, same result as Assign)
+    inline void Resum()
+    {
+        totalWeight = 0;
+        fastWeight = 0;
+        for (int i = 0; i < Size(); i++) {
+            totalWeight += weight[i];
+            fastWeight += fast[i] ? weight[i] : 0;
+        }
+    };
+
+    // Queue a new neutron, appended on next commit
+    inline void Spawn(double x, double y, double vx, double vy, bool fastNeutron, double w = 1)
+    {
+        bornX.push_back(x);
+        bornY.push_back(y);
+        bornVelX.push_back(vx);
+        bornVelY.push_back(vy);
+        bornFast.push_back(fastNeutron);
+        bornWeight.push_back(w);
+    };
+
+    // Mark neutron for removal, removed on next commit
+    inline void Kill(int i)
+    {
+        if (!dead[i]) {
+            dead[i] = 1;
+            killList.push_back(i);
+        }
+    };
+
+    // Is neutron marked for removal
+    inline bool IsDead(int i) const { return dead[i] != 0; };
+
+    // Number of neutrons marked for removal
+    inline int KillCount() const { return killList.size(); };
+
+    // Number of neutrons waiting to be born
+    inline int BirthCount() const { return bornX.size(); };
+
+    // Remove killed neutrons (swap and pop) then append births
+    inline void Commit()
+    {
+        // Descending order so the swapped in tail is always alive
+        std::sort(killList.begin(), killList.end(), std::greater<int>());
+        for (int i : killList) {
+            totalWeight -= weight[i];
+            fastWeight -= fast[i] ? weight[i] : 0;
+            int last = Size() - 1;
+            posX[i] = posX[last];
+            posY[i] = posY[last];
+            velX[i] = velX[last];
+            velY[i] = velY[last];
+            fast[i] = fast[last];
+            weight[i] = weight[last];
+            posX.pop_back();
+            posY.pop_back();
+            velX.pop_back();
+            velY.pop_back();
+            fast.pop_back();
+            weight.pop_back();
+        }
+        killList.clear();
+
+        // Append births
+        posX.insert(posX.end(), bornX.begin(), bornX.end());
+        posY.insert(posY.end(), bornY.begin(), bornY.end());
+        velX.insert(velX.end(), bornVelX.begin(), bornVelX.end());
+        velY.insert(velY.end(), bornVelY.begin(), bornVelY.end());
+        fast.insert(fast.end(), bornFast.begin(), bornFast.end());
+        weight.insert(weight.end(), bornWeight.begin(), bornWeight.end());
+        for (int k = 0; k < bornWeight.size(); k++) {
+            totalWeight += bornWeight[k];
+            fastWeight += bornFast[k] ? bornWeight[k] : 0;
+        }
+        ClearBirths();
+
+        dead.assign(Size(), 0);
+    };
+
+    // Replace all neutrons with count copied from arrays (weights of 1 if w is null)
+    inline void Assign(int count, const double* x, const double* y, const double* vx, const double* vy, const uint8_t* fastNeutron, const double* w = nullptr)
+    {
+        Clear();
+        posX.assign(x, x + count);
+        posY.assign(y, y + count);
+        velX.assign(vx, vx + count);
+        velY.assign(vy, vy + count);
+        fast.assign(fastNeutron, fastNeutron + count);
+        for (uint8_t& f : fast) {
+            f = f != 0;
+        }
+        if (w != nullptr) {
+            weight.assign(w, w + count);
+        } else {
+            weight.assign(count, 1);
+        }
+        dead.assign(count, 0);
+        Resum();
+    };
+
+    // Remove all neutrons, including pending births
+    inline void Clear()
+    {
+        posX.clear();
+        posY.clear();
+        velX.clear();
+        velY.clear();
+        fast.clear();
+        weight.clear();
+        dead.clear();
+        killList.clear();
+        ClearBirths();
+        totalWeight = 0;
+        fastWeight = 0;
+    };
+
+private:
+    double totalWeight = 0;
+    double fastWeight = 0;
+    // Deferred kills
+    std::vector<uint8_t> dead;
+    std::vector<int> killList;
+    // Deferred births
+    std::vector<double> bornX;
+    std::vector<double> bornY;
+    std::vector<double> bornVelX;
+    std::vector<double> bornVelY;
+    std::vector<uint8_t> bornFast;
+    std::vector<double> bornWeight;
+
+    inline void ClearBirths()
+    {
+        bornX.clear();
+        bornY.clear();
+        bornVelX.clear();
+        bornVelY.clear();
+        bornFast.clear();
+        bornWeight.clear();
+    };
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Events kept per thread (oldest are overwritten)
+#define NE_PROFILE_CAPACITY 16384
+
+// Time one scope under a zone name (string literal)
+#define NE_PROFILE_JOIN2(a, b) a##b
+#define NE_PROFILE_JOIN(a, b) NE_PROFILE_JOIN2(a, b)
+#define NE_PROFILE_SCOPE(zone) profileScope NE_PROFILE_JOIN(profileScope_, __LINE__)(zone)
+
+// One finished scope
+struct profileEvent {
+    const char* zone;
+    int64_t start; // ns since profiler epoch
+    int64_t end;
+    int thread; // Index in registration order
+};
+
+// Per-thread event ring, one writer (its thread) and any number of readers
+class profileRing {
+public:
+    profileRing(int index, const char* threadName);
+
+    // Add finished scope (owning thread only)
+    inline void Push(const char* zone, int64_t start, int64_t end)
+    {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        slot* s = &slots[h % NE_PROFILE_CAPACITY];
+        s->zone.store(zone, std::memory_order_relaxed);
+        s->start.store(start, std::memory_order_relaxed);
+        s->end.store(end, std::memory_order_relaxed);
+        head.store(h + 1, std::memory_order_release);
+    };
+
+    // Append events ending after since (ns), skipping any overwritten while reading
+    void Collect(std::vector<profileEvent>* out, int64_t since) const;
+
+    int Index() const { return index; };
+    const char* Name() const { return name; };
+    // Hand ring to a new thread, dropping the old thread's events (no writer or reader may be active)
+    void Reset(const char* threadName);
+
+private:
+    struct slot {
+        std::atomic<const char*> zone { nullptr };
+        std::atomic<int64_t> start { 0 };
+        std::atomic<int64_t> end { 0 };
+    };
+    std::vector<slot> slots;
+    std::atomic<uint64_t> head { 0 };
+    int index;
+    const char* name;
+};
+
+// Process wide scope profiler, off by default
+class profiler {
+public:
+    static void SetEnabled(bool enable) { enabled.store(enable, std::memory_order_relaxed); };
+    static inline bool Enabled() { return enabled.load(std::memory_order_relaxed); };
+
+    // ns since profiler epoch
+    static int64_t Now();
+
+    // Name calling thread in traces (string literal, before its first event)
+    static void NameThread(const char* name);
+
+    // Record a finished scope on the calling thread
+    static void Record(const char* zone, int64_t start, int64_t end);
+
+    // All events ending after since (ns), from every thread
+    static void Collect(std::vector<profileEvent>* out, int64_t since);
+
+    // Write the last seconds of events as a Chrome trace-event JSON file
+    static bool WriteChromeTrace(const char* path, double seconds);
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+// Records its lifetime as one event while the profiler is enabled
+class profileScope {
+public:
+    inline profileScope(const char* name)
+    {
+        zone = name;
+        start = profiler::Enabled() ? profiler::Now() : -1;
+    };
+    inline ~profileScope()
+    {
+        if (start >= 0) {
+            profiler::Record(zone, start, profiler::Now());
+        }
+    };
+
+private:
+    const char* zone;
+    int64_t start;
+};
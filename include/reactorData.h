@@ -0,0 +1,242 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "VectorMath.h"
+#include "core.h"
+#include "rngStream.h"
+
+// Data shared between the fluid engine and its front ends
+
+// Non-owning view of the newest samples of a statRing (index 0 = oldest)
+template <typename T>
+class statView {
+public:
+    statView(const std::atomic<T>* d, long h, int cap, int hist)
+        : data(d)
+        , head(h)
+        , capacity(cap)
+        , history(hist) {};
+
+    int Count() const { return history; };
+    T At(int i) const
+    {
+        long index = head - history + i;
+        if (index < 0) {
+            return 0;
+        }
+        return data[index % capacity].load(std::memory_order_relaxed);
+    };
+
+private:
+    const std::atomic<T>* data;
+    long head;
+    int capacity;
+    int history;
+};
+
+// Fixed capacity sample history
+// One writer (simulation thread) and any number of readers; samples are atomic so never tear,
+// and the spare capacity keeps a view valid while the writer keeps going
+template <typename T>
+class statRing {
+public:
+    statRing(int hist = 60) { SetHistory(hist); };
+
+    // Reallocate (not safe while other threads are reading)
+    void SetHistory(int hist)
+    {
+        history = hist;
+        capacity = hist * NR_STAT_SLACK;
+        data.reset(new std::atomic<T>[capacity]);
+        Zero();
+    };
+    int History() const { return history; };
+
+    // Add newest sample
+    inline void Push(T value)
+    {
+        long h = head.load(std::memory_order_relaxed);
+        data[h % capacity].store(value, std::memory_order_relaxed);
+        head.store(h + 1, std::memory_order_release);
+    };
+
+    // Newest sample
+    inline T Latest() const
+    {
+        long h = head.load(std::memory_order_acquire);
+        return h > 0 ? data[(h - 1) % capacity].load(std::memory_order_relaxed) : 0;
+    };
+
+    // View of the last History() samples as of now
+    inline statView<T> View() const
+    {
+        return statView<T>(data.get(), head.load(std::memory_order_acquire), capacity, history);
+    };
+
+    // Zero all samples
+    inline void Zero()
+    {
+        for (int i = 0; i < capacity; i++) {
+            data[i].store(0, std::memory_order_relaxed);
+        }
+        head.store(0, std::memory_order_release);
+    };
+
+private:
+    std::unique_ptr<std::atomic<T>[]> data;
+    std::atomic<long> head { 0 };
+    int capacity = 0;
+    int history = 0;
+};
+
+class ReactorStatistics {
+private:
+    // Stats to follow
+    statRing<int64_t> m_reactivity; // Physical neutrons
+    statRing<int> m_xenon;
+    statRing<float> m_temp;
+    // Stat history
+    int m_max = 60;
+
+public:
+    // Pull data from memory (non-owning, no copies)
+    statView<int64_t> GetReactivityStats() const { return m_reactivity.View(); }
+    statView<int> GetXenonStats() const { return m_xenon.View(); }
+    statView<float> GetTempStats() const { return m_temp.View(); }
+
+    // Get stat history
+    int GetMax() const { return m_max; }
+
+    // Set stat history (before the simulation thread starts)
+    inline void SetMax(int max)
+    {
+        m_max = max;
+        m_reactivity.SetHistory(max);
+        m_xenon.SetHistory(max);
+        m_temp.SetHistory(max);
+    };
+
+    // Add reactivity data
+    inline void AddReactionData(int64_t stat) { m_reactivity.Push(stat); };
+
+    // Add xenon count data
+    inline void AddXenonData(int stat) { m_xenon.Push(stat); };
+
+    // Add average temperature data
+    inline void AddTempData(float stat) { m_temp.Push(stat); };
+
+    // Zero all data
+    inline void ZeroGraph()
+    {
+        m_reactivity.Zero();
+        m_xenon.Zero();
+        m_temp.Zero();
+    };
+};
+
+enum neutronTransportMode {
+    // Move by velocity * dt, test collisions where the neutron lands
+    TRANSPORT_FIXED_STEP = 0,
+    // Walk the whole path through the lattice cells it crosses (exact at any speed)
+    TRANSPORT_TRAVERSAL
+};
+
+enum neutronFluxMode {
+    // Track neutrons while there are few, switch to the flux field above continuumAbove and back below continuumBelow
+    FLUX_AUTO = 0,
+    // Always track individual neutrons
+    FLUX_PARTICLES,
+    // Always use the flux field
+    FLUX_CONTINUUM
+};
+
+struct ReactorSettings {
+    // Random seed (applied on fluidEngine::Start)
+    uint64_t seed = NR_DEFAULT_SEED;
+    // Neutron transport threads (applied on fluidEngine::Start, 0 = one per hardware thread)
+    int workerThreads = 0;
+    // Neutron movement (neutronTransportMode)
+    int transportMode = TRANSPORT_FIXED_STEP;
+    // Weighted transport: each neutron is a packet standing for many (or a fraction of one),
+    // kept near neutronPackets packets whatever the physical population
+    bool weightedNeutrons = false;
+    int neutronPackets = 20000;
+    // Particles or two-group flux field (neutronFluxMode), switching with hysteresis in FLUX_AUTO
+    int fluxMode = FLUX_AUTO;
+    int continuumAbove = 250000;
+    int continuumBelow = 100000;
+    // Simulation speed multiplier for the simulation thread (0 = as fast as possible)
+    float simulationSpeed = 1;
+    // Neutron settings
+    int fissionNeutronCount = 3;
+    float fissionNeutronSpeed = 3;
+    float fissionFastNeutronSpeed = 6;
+    float decayChance = 0.002;
+    float waterAbsorptionChance = 0.02;
+    // Reactor material settings
+    float xenonDecayChance = 0.003;
+    // Heat transfer settings
+    float heatDissipate = 0;
+    float waterFlow = 30;
+    float heatTransfer = 15;
+    // Graph data, sampled every statInterval ticks (1 = every tick)
+    ReactorStatistics stats;
+    int statInterval = NE_TARGET_TICKRATE;
+};
+
+// Draw circle
+struct CircleData {
+    VM::Vector2 position = VM::Vector2(0, 0);
+    float radius = 1;
+    int colourID = 0;
+    CircleData(VM::Vector2 pos, float rad, int colour = 0)
+    {
+        position = pos;
+        radius = rad;
+        colourID = colour;
+    };
+};
+
+// Draw rectangle
+struct RectangleData {
+    VM::Vector2 position = VM::Vector2(0, 0);
+    VM::Vector2 size = VM::Vector2(0, 0);
+
+    int colourID = 0;
+    RectangleData(VM::Vector2 pos, VM::Vector2 scale, int colour = 0)
+    {
+        position = pos;
+        size = scale;
+        colourID = colour;
+    };
+};
+
+// Everything the renderer needs for one frame
+struct RenderSnapshot {
+    std::vector<CircleData> reactorMaterial;
+    std::vector<CircleData> neutrons;
+    std::vector<RectangleData> reactorWater;
+    std::vector<RectangleData> reactorRod;
+    int64_t neutronCount = 0;
+    int64_t fastCount = 0;
+    int packetCount = 0; // Neutron packets drawn (neutronCount is the physical population)
+    bool continuum = false; // Neutrons are held as a flux field and not drawn
+    int xenonCount = 0;
+    float averageTemperature = 0;
+    float maxTemperature = 0;
+    int rodBanks = 0;
+    float bankHeight[NR_MAX_ROD_BANKS] = {}; // Insertion each bank is set to
+    uint64_t bankVersion = 0; // Changes when banks were set other than by a UI request
+    int sizeX = 0;
+    int sizeY = 0;
+    // Engine change counters this slot was last encoded at (0 = never, forces a full encode)
+    uint64_t layoutVersion = 0;
+    uint64_t atomChange = 0;
+    uint64_t rodVersion = 0;
+};
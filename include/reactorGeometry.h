@@ -0,0 +1,30 @@
+#pragma once
+
+#include "core.h"
+
+// Reactor lattice size, chosen at runtime
+struct ReactorGeometry {
+    int sizeX = NR_DEFAULT_SIZE_X;
+    int sizeY = NR_DEFAULT_SIZE_Y;
+
+    ReactorGeometry() { };
+    ReactorGeometry(int x, int y)
+    {
+        sizeX = x;
+        sizeY = y;
+    };
+
+    inline int Cells() const { return sizeX * sizeY; };
+    inline bool Contains(int x, int y) const { return x >= 0 && x < sizeX && y >= 0 && y < sizeY; };
+    // Row-major cell index
+    inline int Index(int x, int y) const { return x + y * sizeX; };
+    inline bool Is(int x, int y) const { return sizeX == x && sizeY == y; };
+};
+
+// Geometry known at compile time, lets hot kernels fold the size into constants
+// SizeX/SizeY of 0 falls back to the runtime geometry
+template <int SizeX, int SizeY>
+struct fixedGeometry {
+    static inline int X(const ReactorGeometry& g) { return SizeX != 0 ? SizeX : g.sizeX; };
+    static inline int Y(const ReactorGeometry& g) { return SizeY != 0 ? SizeY : g.sizeY; };
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "VectorMath.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// xoshiro256** random stream
+// Streams built from the same seed with different ids never overlap (2^128 apart)
+class rngStream {
+public:
+    uint64_t state[4];
+
+    rngStream(uint64_t seed = 1, uint64_t stream = 0) { Seed(seed, stream); };
+
+    // Seed stream from (seed, id)
+    inline void Seed(uint64_t seed, uint64_t stream = 0)
+    {
+        // Expand seed with splitmix64
+        uint64_t x = seed;
+        for (int i = 0; i < 4; i++) {
+            x += 0x9E3779B97F4A7C15ull;
+            uint64_t z = x;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            state[i] = z ^ (z >> 31);
+        }
+        // Jump to independent stream
+        for (uint64_t i = 0; i < stream; i++) {
+            Jump();
+        }
+    };
+
+    // Next raw 64 bits
+    inline uint64_t Next()
+    {
+        const uint64_t result = Rotl(state[1] * 5, 7) * 9;
+        const uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = Rotl(state[3], 45);
+        return result;
+    };
+
+    // Uniform double in [0, 1)
+    inline double Uniform() { return (Next() >> 11) * 0x1.0p-53; };
+
+    // Random double in range
+    inline double Range(double fMin, double fMax) { return fMin + Uniform() * (fMax - fMin); };
+
+    // Random int in range (inclusive)
+    inline int RangeInt(int fMin, int fMax) { return fMin + (int)(Uniform() * ((double)fMax + 1 - fMin)); };
+
+    // Random 2D direction with magnitude of 1
+    inline VM::Vector2 UnitVector()
+    {
+        double theta = Range(0, 2 * M_PI);
+        return VM::Vector2(cos(theta), sin(theta));
+    };
+
+    // Failed trials before the next success, for trials that succeed with chance p (logMiss = log(1 - p), p > 0)
+    inline long long Geometric(double logMiss)
+    {
+        double gap = std::floor(std::log(1.0 - Uniform()) / logMiss);
+        return gap < 1e18 ? (long long)gap : (long long)1e18;
+    };
+
+    // Advance 2^128 steps (start of next independent stream)
+    inline void Jump()
+    {
+        static const uint64_t JUMP[] = { 0x180EC6D33CFD0ABAull, 0xD5A61266F0C9392Cull, 0xA9582618E03FC9AAull, 0x39ABDC4529B1661Cull };
+        uint64_t s[4] = { 0, 0, 0, 0 };
+        for (int i = 0; i < 4; i++) {
+            for (int b = 0; b < 64; b++) {
+                if (JUMP[i] & (1ull << b)) {
+                    s[0] ^= state[0];
+                    s[1] ^= state[1];
+                    s[2] ^= state[2];
+                    s[3] ^= state[3];
+                }
+                Next();
+            }
+        }
+        state[0] = s[0];
+        state[1] = s[1];
+        state[2] = s[2];
+        state[3] = s[3];
+    };
+
+private:
+    static inline uint64_t Rotl(const uint64_t x, int k) { return (x << k) | (x >> (64 - k)); };
+};
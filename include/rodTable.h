@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+class controlRod {
+public:
+    float xPosition;
+    float height;
+    bool moderator;
+    int bank; // Rod bank driving this rod (-1 = not driven)
+
+    controlRod(float x, float insertion, bool mod, int b = -1)
+    {
+        xPosition = x;
+        height = insertion;
+        moderator = mod;
+        bank = b;
+    }
+};
+
+// What a neutron meets in one rod column
+// Neutrons absorb below absorberTip and fast neutrons are moderated above moderatorTip + RR_CR_PADDING
+struct rodColumn {
+    float absorberTip;
+    float moderatorTip;
+};
+
+// Rod extents per column, so a neutron's rod check is one indexed load whatever the rod count
+// Rods sit on cell boundaries: column k holds neutrons with x + 0.5 in (k - 0.5, k + 0.5)
+class rodTable {
+public:
+    // Fold rods into columns (tips in lattice units of a core sizeY tall)
+    // Rods sharing a column combine: the deepest absorber and the shallowest moderator win
+    void Build(const std::vector<controlRod>& rods, int sizeX, int sizeY)
+    {
+        first = 0;
+        int last = sizeX;
+        for (const controlRod& rod : rods) {
+            first = std::min(first, (int)std::lround(rod.xPosition));
+            last = std::max(last, (int)std::lround(rod.xPosition));
+        }
+        columns.assign(last - first + 1, empty);
+        for (const controlRod& rod : rods) {
+            rodColumn& column = columns[std::lround(rod.xPosition) - first];
+            float tip = (rod.height / 100) * sizeY;
+            column.absorberTip = std::max(column.absorberTip, tip);
+            column.moderatorTip = std::min(column.moderatorTip, tip);
+        }
+    };
+
+    // Column k (empty outside the table)
+    inline const rodColumn& Column(int k) const
+    {
+        unsigned index = k - first;
+        return index < columns.size() ? columns[index] : empty;
+    };
+    // Column holding a neutron at x (open intervals, a neutron exactly on a column edge meets no rod)
+    inline const rodColumn& At(double x) const
+    {
+        double u = x + 0.5;
+        int k = std::floor(u + 0.5);
+        if (u <= k - 0.5) {
+            k--; // u + 0.5 rounded up
+        }
+        return u > k - 0.5 && u < k + 0.5 ? Column(k) : empty;
+    };
+    inline bool Empty(const rodColumn& column) const { return column.absorberTip == empty.absorberTip; };
+
+    int First() const { return first; };
+    int Last() const { return first + (int)columns.size() - 1; };
+
+private:
+    std::vector<rodColumn> columns;
+    int first = 0;
+    static constexpr rodColumn empty = { -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity() };
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread
+template <typename T>
+class spscQueue {
+public:
+    // Capacity is rounded up to a power of two
+    spscQueue(size_t capacity = 1024)
+    {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        slots.resize(size);
+        mask = size - 1;
+    };
+
+    // Producer only, returns false if full
+    inline bool TryPush(const T& value)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) > mask) {
+            return false;
+        }
+        slots[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    };
+
+    // Consumer only, returns false if empty
+    inline bool TryPop(T* value)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        *value = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    };
+
+    inline bool Empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); };
+
+private:
+    std::vector<T> slots;
+    size_t mask;
+    // Separate cache lines so producer and consumer do not fight over them
+    alignas(64) std::atomic<size_t> head { 0 };
+    alignas(64) std::atomic<size_t> tail { 0 };
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core.h"
+#include "spscQueue.h"
+
+#define NR_TELEMETRY_QUEUE 8192
+#define NR_TELEMETRY_BLOCK 4096 // Rows per columnar block
+
+// Reactor metrics for one sampled tick
+struct telemetrySample {
+    int64_t tick;
+    int64_t neutrons; // Physical population (summed packet weights)
+    int64_t fast;
+    int64_t thermal;
+    int32_t xenon;
+    float averageTemperature;
+    float maxTemperature;
+    int32_t banks; // Rod banks in bankHeight
+    float bankHeight[NR_MAX_ROD_BANKS]; // Insertion of each rod bank
+    int64_t fissions; // Since the previous sample
+};
+
+enum telemetryFormat {
+    TELEMETRY_CSV = 0,
+    // Header (magic "NIPTLM1", uint32 version 3, uint32 banks), then blocks of
+    // uint32 rows, uint32 reserved, and one array per column in telemetrySample order (one per bank, no banks column)
+    // Version 3 widened neutrons, fast, thermal and fissions to int64
+    TELEMETRY_BINARY
+};
+
+// Streams samples to disk on a background thread
+// The simulation only pushes to a bounded queue, a full queue drops the sample instead of waiting
+// A file holds one column per rod bank, so a change in the bank count starts a new file
+class telemetrySink {
+public:
+    telemetrySink() { };
+    ~telemetrySink() { Close(); };
+
+    // Start writing to base_0000.csv/.bin, rotating to a new file past rotateBytes (0 = never)
+    // Keep one sample every decimation ticks
+    bool Open(const std::string& base, telemetryFormat format, int decimation, long long rotateBytes);
+    // Flush queue and stop writer
+    void Close();
+    bool IsOpen() const { return running.load(std::memory_order_acquire); };
+
+    // Should this tick be sampled
+    inline bool Wants(long tick) const { return IsOpen() && tick % decimation == 0; };
+    // Queue sample (simulation thread only)
+    inline void Push(const telemetrySample& sample)
+    {
+        if (!queue.TryPush(sample)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+
+    long long Dropped() const { return dropped.load(std::memory_order_relaxed); };
+    long long Written() const { return written.load(std::memory_order_relaxed); };
+
+private:
+    void WriterLoop();
+    bool OpenFile();
+    void WriteHeader(int banks);
+    void CloseFile();
+    void WriteSample(const telemetrySample& sample);
+    void FlushBlock();
+
+    spscQueue<telemetrySample> queue { NR_TELEMETRY_QUEUE };
+    std::thread writer;
+    std::atomic<bool> running { false };
+    std::atomic<long long> dropped { 0 };
+    std::atomic<long long> written { 0 };
+    // Writer thread state
+    std::string basePath;
+    telemetryFormat fileFormat = TELEMETRY_CSV;
+    int decimation = 1;
+    long long rotateBytes = 0;
+    FILE* file = nullptr;
+    int fileIndex = 0;
+    long long fileBytes = 0;
+    int fileBanks = -1; // Bank columns of the open file (-1 = header not written yet)
+    std::vector<telemetrySample> block;
+};
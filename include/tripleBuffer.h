@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+
+// Lock-free single writer / single reader triple buffer
+// The writer fills Back() and publishes it, the reader always sees the latest complete slot
+template <typename T>
+class tripleBuffer {
+public:
+    // Writer: slot being filled
+    T& Back() { return slots[back]; };
+
+    // Writer: hand the filled slot to the reader
+    void Publish()
+    {
+        int old = middle.exchange(back | FRESH_BIT, std::memory_order_acq_rel);
+        back = old & INDEX_MASK;
+    };
+
+    // Reader: take the latest published slot, returns false if nothing new
+    bool Acquire()
+    {
+        if ((middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0) {
+            return false;
+        }
+        int old = middle.exchange(front, std::memory_order_acq_rel);
+        front = old & INDEX_MASK;
+        return true;
+    };
+
+    // Reader: latest acquired slot
+    const T& Front() const { return slots[front]; };
+
+private:
+    static const int INDEX_MASK = 3;
+    static const int FRESH_BIT = 4;
+
+    T slots[3];
+    int back = 0;
+    std::atomic<int> middle { 1 };
+    int front = 2;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+#include "workerPool.h"
+
+// Stencil kernel implementations
+enum waterKernel {
+    WATER_KERNEL_AUTO = 0,
+    WATER_KERNEL_SCALAR,
+    WATER_KERNEL_AVX2
+};
+
+// Dense row-major water temperature grid
+// Each step reads one buffer and writes the other, so the result does not depend on update order
+class waterGrid {
+public:
+    // Allocate width * height cells at zero
+    void Resize(int w, int h);
+    int Width() const { return width; };
+    int Height() const { return height; };
+    int Size() const { return width * height; };
+
+    // Current temperatures (row-major, index = x + y * width)
+    // Call Refresh() after writing through the mutable pointer
+    float* Temperatures() { return current.data(); };
+    const float* Temperatures() const { return current.data(); };
+    float At(int x, int y) const { return current[x + y * width]; };
+    // Write one cell, keeping the sum and max current
+    void Set(int x, int y, float t);
+
+    // Sum and max of current temperatures, reduced during Step so reads are O(1)
+    double Sum() const { return sum; };
+    float Max();
+    // Recompute sum and max after external writes
+    void Refresh();
+
+    // Advance one step
+    // heat: per-cell heat added this step, dissipate: heat lost this step,
+    // flow: fraction exchanged with the cell above, inlet: bottom row temperature
+    void Step(const float* heat, float dissipate, float flow, float inlet, workerPool* workers);
+
+    // Kernel selection (auto picks AVX2 when the CPU has it)
+    void SetKernel(waterKernel k) { kernel = k; };
+    waterKernel ActiveKernel() const;
+    static bool HasAVX2();
+
+private:
+    int width = 0;
+    int height = 0;
+    std::vector<float> current;
+    std::vector<float> next;
+    waterKernel kernel = WATER_KERNEL_AUTO;
+    // Aggregates of current
+    double sum = 0;
+    float max = 0;
+    bool maxStale = false; // The old max was overwritten by Set
+    // Per-chunk partial sums and maxes of the last Step
+    std::vector<double> chunkSum;
+    std::vector<float> chunkMax;
+};
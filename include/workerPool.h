@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads that split a job into numbered chunks
+class workerPool {
+public:
+    workerPool();
+    ~workerPool();
+    // Spawn workers (0 = one per hardware thread)
+    void Start(int threads);
+    void Stop();
+    // Total threads working on a job (workers + caller)
+    int ThreadCount() const { return workers.size() + 1; };
+    // Run job(chunk) for every chunk in [0, chunks), blocks until all are done
+    void Run(int chunks, const std::function<void(int)>& job);
+
+private:
+    void WorkerLoop();
+    void DoChunks();
+
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int)>* currentJob = nullptr;
+    int chunkCount = 0;
+    std::atomic<int> nextChunk;
+    int activeWorkers = 0;
+    long generation = 0;
+    bool stopping = false;
+};
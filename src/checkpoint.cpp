@@ -0,0 +1,511 @@
+// Reactor checkpoint save and load (see checkpoint.h for the layout)
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "../include/checkpoint.h"
+#include "../include/fluidEngine.h"
+#include "../include/mappedFile.h"
+#include "../include/profiler.h"
+
+// Bytes needed to reach the next aligned offset
+static uint64_t AlignPadding(uint64_t offset)
+{
+    return (NR_CHECKPOINT_ALIGN - offset % NR_CHECKPOINT_ALIGN) % NR_CHECKPOINT_ALIGN;
+}
+
+// Sequential section writer, table is filled in at the end
+class checkpointWriter {
+public:
+    checkpointWriter(FILE* f)
+    {
+        file = f;
+        checkpointHeader header;
+        memcpy(header.magic, NR_CHECKPOINT_MAGIC, sizeof(header.magic));
+        header.version = NR_CHECKPOINT_VERSION;
+        header.sectionCount = CHECKPOINT_SECTION_COUNT;
+        fwrite(&header, sizeof(header), 1, file);
+        // Table placeholder
+        sections.resize(CHECKPOINT_SECTION_COUNT);
+        fwrite(sections.data(), sizeof(checkpointSection), sections.size(), file);
+        offset = sizeof(header) + sizeof(checkpointSection) * sections.size();
+    };
+
+    void Begin(checkpointSectionId id, uint64_t count)
+    {
+        current = &sections[id - 1];
+        current->id = id;
+        current->reserved = 0;
+        current->count = count;
+        current->offset = offset;
+        current->size = 0;
+    };
+
+    // Append array to current section, padded to alignment
+    void Write(const void* data, uint64_t bytes)
+    {
+        if (bytes > 0) {
+            fwrite(data, 1, bytes, file);
+        }
+        static const uint8_t zeros[NR_CHECKPOINT_ALIGN] = {};
+        uint64_t pad = AlignPadding(bytes);
+        fwrite(zeros, 1, pad, file);
+        offset += bytes + pad;
+        current->size += bytes + pad;
+    };
+
+    // Write section table, returns false if any write failed
+    bool Finish()
+    {
+        fseek(file, sizeof(checkpointHeader), SEEK_SET);
+        fwrite(sections.data(), sizeof(checkpointSection), sections.size(), file);
+        return ferror(file) == 0;
+    };
+
+private:
+    FILE* file;
+    std::vector<checkpointSection> sections;
+    checkpointSection* current = nullptr;
+    uint64_t offset = 0;
+};
+
+// Validated view of a mapped checkpoint
+class checkpointReader {
+public:
+    // Check header and that every section lies inside the file
+    bool Open(const mappedFile* mapped)
+    {
+        file = mapped;
+        if (file->Size() < sizeof(checkpointHeader)) {
+            printf("Checkpoint: not a checkpoint file\n");
+            return false;
+        }
+        const checkpointHeader* header = (const checkpointHeader*)file->Data();
+        if (memcmp(header->magic, NR_CHECKPOINT_MAGIC, sizeof(header->magic)) != 0) {
+            printf("Checkpoint: not a checkpoint file\n");
+            return false;
+        }
+        if (header->version < NR_CHECKPOINT_VERSION_MIN || header->version > NR_CHECKPOINT_VERSION) {
+            printf("Checkpoint: version %u not supported (expected %d to %d)\n", header->version, NR_CHECKPOINT_VERSION_MIN, NR_CHECKPOINT_VERSION);
+            return false;
+        }
+        version = header->version;
+        uint64_t tableEnd = sizeof(checkpointHeader) + (uint64_t)header->sectionCount * sizeof(checkpointSection);
+        if (tableEnd > file->Size()) {
+            printf("Checkpoint: section table truncated\n");
+            return false;
+        }
+        table = (const checkpointSection*)(file->Data() + sizeof(checkpointHeader));
+        tableCount = header->sectionCount;
+        for (uint32_t i = 0; i < tableCount; i++) {
+            if (table[i].offset % NR_CHECKPOINT_ALIGN != 0 || table[i].offset < tableEnd || table[i].offset > file->Size() || table[i].size > file->Size() - table[i].offset) {
+                printf("Checkpoint: section %u out of bounds\n", table[i].id);
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // Is section present (for optional sections)
+    bool Has(checkpointSectionId id) const
+    {
+        for (uint32_t i = 0; i < tableCount; i++) {
+            if (table[i].id == id) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // Section with at least the given bytes, or nullptr
+    const checkpointSection* Find(checkpointSectionId id, uint64_t minimumBytes) const
+    {
+        for (uint32_t i = 0; i < tableCount; i++) {
+            if (table[i].id == id) {
+                if (table[i].size < minimumBytes) {
+                    printf("Checkpoint: section %u truncated\n", id);
+                    return nullptr;
+                }
+                return &table[i];
+            }
+        }
+        printf("Checkpoint: section %u missing\n", id);
+        return nullptr;
+    };
+
+    const uint8_t* Data(const checkpointSection* section) const { return file->Data() + section->offset; };
+    uint32_t Version() const { return version; };
+
+private:
+    const mappedFile* file = nullptr;
+    const checkpointSection* table = nullptr;
+    uint32_t tableCount = 0;
+    uint32_t version = 0;
+};
+
+// Bytes taken by an array of count elements once padded
+static uint64_t Padded(uint64_t bytes)
+{
+    return bytes + AlignPadding(bytes);
+}
+
+// Save whole reactor state
+bool fluidEngine::SaveCheckpoint(const char* path)
+{
+    NE_PROFILE_SCOPE("SaveCheckpoint");
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        printf("Checkpoint: could not write %s\n", path);
+        return false;
+    }
+    checkpointWriter writer(file);
+
+    // Scalars
+    checkpointState state;
+    memset(&state, 0, sizeof(state));
+    const rngStream* streams[5] = { &rngCore, &rngTransport, &rngDecay, &rngHeat, &rngUser };
+    for (int i = 0; i < 5; i++) {
+        memcpy(state.rng[i], streams[i]->state, sizeof(state.rng[i]));
+    }
+    state.seed = settings.seed;
+    state.tickCount = tickCount;
+    state.sizeX = geometry.sizeX;
+    state.sizeY = geometry.sizeY;
+    state.statUpdate = statUpdate;
+    state.fissionNeutronCount = settings.fissionNeutronCount;
+    state.fissionNeutronSpeed = settings.fissionNeutronSpeed;
+    state.fissionFastNeutronSpeed = settings.fissionFastNeutronSpeed;
+    state.decayChance = settings.decayChance;
+    state.waterAbsorptionChance = settings.waterAbsorptionChance;
+    state.xenonDecayChance = settings.xenonDecayChance;
+    state.heatDissipate = settings.heatDissipate;
+    state.waterFlow = settings.waterFlow;
+    state.heatTransfer = settings.heatTransfer;
+    state.transportMode = settings.transportMode;
+    state.weightedNeutrons = settings.weightedNeutrons;
+    state.neutronPackets = settings.neutronPackets;
+    state.fluxMode = settings.fluxMode;
+    state.continuumAbove = settings.continuumAbove;
+    state.continuumBelow = settings.continuumBelow;
+    for (int b = 0; b < 5; b++) {
+        state.rodHeight[b] = BankHeight(b);
+    }
+    writer.Begin(CHECKPOINT_STATE, 1);
+    writer.Write(&state, sizeof(state));
+
+    // Atoms
+    int atoms = reactorMaterial.size();
+    std::vector<int32_t> atomX(atoms);
+    std::vector<int32_t> atomY(atoms);
+    std::vector<uint8_t> atomElement(atoms);
+    for (int i = 0; i < atoms; i++) {
+        atomX[i] = reactorMaterial[i].position.x;
+        atomY[i] = reactorMaterial[i].position.y;
+        atomElement[i] = reactorMaterial[i].element;
+    }
+    writer.Begin(CHECKPOINT_ATOMS, atoms);
+    writer.Write(atomX.data(), atoms * sizeof(int32_t));
+    writer.Write(atomY.data(), atoms * sizeof(int32_t));
+    writer.Write(atomElement.data(), atoms);
+
+    // Element groups in index order, so regeneration picks the same atoms after a load
+    std::vector<int32_t> elementOrder;
+    elementOrder.reserve(atoms);
+    for (int e = 0; e < NR_ELEMENT_COUNT; e++) {
+        elementOrder.insert(elementOrder.end(), atomElements.Members(e).begin(), atomElements.Members(e).end());
+    }
+    writer.Begin(CHECKPOINT_ELEMENT_ORDER, elementOrder.size());
+    writer.Write(elementOrder.data(), elementOrder.size() * sizeof(int32_t));
+
+    // Water
+    writer.Begin(CHECKPOINT_WATER, reactorWater.Size());
+    writer.Write(reactorWater.Temperatures(), reactorWater.Size() * sizeof(float));
+
+    // Neutrons (committed, nothing is pending between ticks)
+    int count = neutrons.Size();
+    writer.Begin(CHECKPOINT_NEUTRONS, count);
+    writer.Write(neutrons.posX.data(), count * sizeof(double));
+    writer.Write(neutrons.posY.data(), count * sizeof(double));
+    writer.Write(neutrons.velX.data(), count * sizeof(double));
+    writer.Write(neutrons.velY.data(), count * sizeof(double));
+    writer.Write(neutrons.fast.data(), count);
+    writer.Begin(CHECKPOINT_NEUTRON_WEIGHTS, count);
+    writer.Write(neutrons.weight.data(), count * sizeof(double));
+
+    // Flux field (the neutron arrays are empty while it holds the neutrons)
+    int fluxCells = continuum ? flux.Size() : 0;
+    writer.Begin(CHECKPOINT_FLUX, fluxCells);
+    writer.Write(flux.Fast(), fluxCells * sizeof(float));
+    writer.Write(flux.Thermal(), fluxCells * sizeof(float));
+
+    // Rods
+    std::vector<checkpointRod> rods(controlRods.size());
+    for (int i = 0; i < controlRods.size(); i++) {
+        rods[i].xPosition = controlRods[i].xPosition;
+        rods[i].height = controlRods[i].height;
+        rods[i].moderator = controlRods[i].moderator;
+    }
+    writer.Begin(CHECKPOINT_RODS, rods.size());
+    writer.Write(rods.data(), rods.size() * sizeof(checkpointRod));
+    std::vector<int32_t> banks(controlRods.size());
+    for (int i = 0; i < controlRods.size(); i++) {
+        banks[i] = controlRods[i].bank;
+    }
+    writer.Begin(CHECKPOINT_ROD_BANKS, banks.size());
+    writer.Write(banks.data(), banks.size() * sizeof(int32_t));
+    writer.Begin(CHECKPOINT_BANK_HEIGHTS, rodBanks.size());
+    writer.Write(bankHeight, rodBanks.size() * sizeof(float));
+
+    // Statistics history
+    statView<int64_t> reactivity = settings.stats.GetReactivityStats();
+    statView<int> xenon = settings.stats.GetXenonStats();
+    statView<float> temperature = settings.stats.GetTempStats();
+    int history = reactivity.Count();
+    std::vector<int64_t> reactivityData(history);
+    std::vector<int32_t> xenonData(history);
+    std::vector<float> temperatureData(history);
+    for (int i = 0; i < history; i++) {
+        reactivityData[i] = reactivity.At(i);
+        xenonData[i] = xenon.At(i);
+        temperatureData[i] = temperature.At(i);
+    }
+    writer.Begin(CHECKPOINT_STATS, history);
+    writer.Write(reactivityData.data(), history * sizeof(int64_t));
+    writer.Write(xenonData.data(), history * sizeof(int32_t));
+    writer.Write(temperatureData.data(), history * sizeof(float));
+
+    bool ok = writer.Finish();
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        printf("Checkpoint: could not write %s\n", path);
+    }
+    return ok;
+}
+
+// Replace whole reactor state (engine is unchanged if the file is rejected)
+// Worker threads and simulation speed are kept, they do not change the result
+bool fluidEngine::LoadCheckpoint(const char* path)
+{
+    NE_PROFILE_SCOPE("LoadCheckpoint");
+    mappedFile mapped;
+    if (!mapped.Open(path)) {
+        printf("Checkpoint: could not open %s\n", path);
+        return false;
+    }
+    checkpointReader reader;
+    if (!reader.Open(&mapped)) {
+        return false;
+    }
+
+    // Validate every section before touching the engine
+    const checkpointSection* stateSection = reader.Find(CHECKPOINT_STATE, NR_CHECKPOINT_STATE_MIN);
+    if (stateSection == nullptr) {
+        return false;
+    }
+    // Fields missing from older files read as 0 (version 1 stops at NR_CHECKPOINT_STATE_MIN)
+    uint64_t stateBytes = reader.Version() < 2 ? NR_CHECKPOINT_STATE_MIN : sizeof(checkpointState);
+    checkpointState state;
+    memset(&state, 0, sizeof(state));
+    memcpy(&state, reader.Data(stateSection), std::min<uint64_t>(stateSection->size, stateBytes));
+    if (state.sizeX < 1 || state.sizeY < 1) {
+        printf("Checkpoint: invalid core size\n");
+        return false;
+    }
+    uint64_t cells = (uint64_t)state.sizeX * state.sizeY;
+    const checkpointSection* atomSection = reader.Find(CHECKPOINT_ATOMS, 0);
+    const checkpointSection* waterSection = reader.Find(CHECKPOINT_WATER, Padded(cells * sizeof(float)));
+    const checkpointSection* neutronSection = reader.Find(CHECKPOINT_NEUTRONS, 0);
+    const checkpointSection* rodSection = reader.Find(CHECKPOINT_RODS, 0);
+    const checkpointSection* statSection = reader.Find(CHECKPOINT_STATS, 0);
+    if (atomSection == nullptr || waterSection == nullptr || neutronSection == nullptr || rodSection == nullptr || statSection == nullptr) {
+        return false;
+    }
+    const checkpointSection* bankSection = nullptr;
+    if (reader.Has(CHECKPOINT_ROD_BANKS)) {
+        bankSection = reader.Find(CHECKPOINT_ROD_BANKS, Padded(rodSection->count * sizeof(int32_t)));
+        if (bankSection == nullptr) {
+            return false;
+        }
+    }
+    const checkpointSection* bankHeightSection = nullptr;
+    if (reader.Has(CHECKPOINT_BANK_HEIGHTS)) {
+        bankHeightSection = reader.Find(CHECKPOINT_BANK_HEIGHTS, 0);
+        if (bankHeightSection->count > NR_MAX_ROD_BANKS || bankHeightSection->size < bankHeightSection->count * sizeof(float)) {
+            printf("Checkpoint: bank heights out of range\n");
+            return false;
+        }
+    }
+    uint64_t atoms = atomSection->count;
+    uint64_t count = neutronSection->count;
+    const checkpointSection* weightSection = nullptr;
+    if (reader.Version() >= 2 && reader.Has(CHECKPOINT_NEUTRON_WEIGHTS)) {
+        weightSection = reader.Find(CHECKPOINT_NEUTRON_WEIGHTS, Padded(count * sizeof(double)));
+        if (weightSection == nullptr || weightSection->count != count) {
+            printf("Checkpoint: neutron weights do not match neutrons\n");
+            return false;
+        }
+    }
+    const checkpointSection* fluxSection = nullptr;
+    if (reader.Version() >= 2 && reader.Has(CHECKPOINT_FLUX)) {
+        fluxSection = reader.Find(CHECKPOINT_FLUX, 0);
+        if (fluxSection->count == 0) {
+            fluxSection = nullptr;
+        } else if (fluxSection->count != cells || fluxSection->size < Padded(cells * sizeof(float)) * 2) {
+            printf("Checkpoint: flux does not match core size\n");
+            return false;
+        }
+    }
+    uint64_t history = statSection->count;
+    uint64_t reactivityBytes = reader.Version() < 3 ? sizeof(int32_t) : sizeof(int64_t);
+    if (waterSection->count != cells
+        || atomSection->size < Padded(atoms * sizeof(int32_t)) * 2 + Padded(atoms)
+        || neutronSection->size < Padded(count * sizeof(double)) * 4 + Padded(count)
+        || rodSection->size < rodSection->count * sizeof(checkpointRod)
+        || statSection->size < Padded(history * reactivityBytes) + Padded(history * sizeof(int32_t)) + Padded(history * sizeof(float))) {
+        printf("Checkpoint: section sizes do not match\n");
+        return false;
+    }
+    const uint8_t* elements = reader.Data(atomSection) + Padded(atoms * sizeof(int32_t)) * 2;
+    for (uint64_t i = 0; i < atoms; i++) {
+        if (elements[i] >= NR_ELEMENT_COUNT) {
+            printf("Checkpoint: unknown element %d\n", elements[i]);
+            return false;
+        }
+    }
+    // Element order must list every atom once, grouped by element (older files rebuild it in atom order)
+    const int32_t* elementOrder = nullptr;
+    if (reader.Has(CHECKPOINT_ELEMENT_ORDER)) {
+        const checkpointSection* orderSection = reader.Find(CHECKPOINT_ELEMENT_ORDER, Padded(atoms * sizeof(int32_t)));
+        if (orderSection == nullptr || orderSection->count != atoms) {
+            printf("Checkpoint: element order does not match atoms\n");
+            return false;
+        }
+        elementOrder = (const int32_t*)reader.Data(orderSection);
+        std::vector<uint8_t> seen(atoms, 0);
+        int element = 0;
+        for (uint64_t k = 0; k < atoms; k++) {
+            int32_t a = elementOrder[k];
+            if (a < 0 || a >= atoms || seen[a] || elements[a] < element) {
+                printf("Checkpoint: element order does not match atoms\n");
+                return false;
+            }
+            seen[a] = 1;
+            element = elements[a];
+        }
+    }
+
+    // Scalars
+    rngStream* streams[5] = { &rngCore, &rngTransport, &rngDecay, &rngHeat, &rngUser };
+    for (int i = 0; i < 5; i++) {
+        memcpy(streams[i]->state, state.rng[i], sizeof(state.rng[i]));
+    }
+    settings.seed = state.seed;
+    tickCount = state.tickCount;
+    statUpdate = state.statUpdate;
+    settings.fissionNeutronCount = state.fissionNeutronCount;
+    settings.fissionNeutronSpeed = state.fissionNeutronSpeed;
+    settings.fissionFastNeutronSpeed = state.fissionFastNeutronSpeed;
+    settings.decayChance = state.decayChance;
+    settings.waterAbsorptionChance = state.waterAbsorptionChance;
+    settings.xenonDecayChance = state.xenonDecayChance;
+    settings.heatDissipate = state.heatDissipate;
+    settings.waterFlow = state.waterFlow;
+    settings.heatTransfer = state.heatTransfer;
+    settings.transportMode = state.transportMode;
+    settings.weightedNeutrons = state.weightedNeutrons != 0;
+    if (state.neutronPackets > 0) {
+        settings.neutronPackets = state.neutronPackets;
+    }
+    settings.fluxMode = state.fluxMode;
+    if (state.continuumAbove > 0) {
+        settings.continuumAbove = state.continuumAbove;
+        settings.continuumBelow = state.continuumBelow;
+    }
+
+    // Core (SetGeometry clears material, water, rods and neutrons)
+    SetGeometry(ReactorGeometry(state.sizeX, state.sizeY));
+
+    // Atoms, first atom in a cell owns it (as AddReactorMaterial)
+    const uint8_t* data = reader.Data(atomSection);
+    const int32_t* atomX = (const int32_t*)data;
+    const int32_t* atomY = (const int32_t*)(data + Padded(atoms * sizeof(int32_t)));
+    const uint8_t* atomElement = data + Padded(atoms * sizeof(int32_t)) * 2;
+    reactorMaterial.reserve(atoms);
+    for (uint64_t i = 0; i < atoms; i++) {
+        reactorMaterial.push_back(atom(atomX[i], atomY[i], atomElement[i]));
+        atomElements.Add(i, atomElement[i]);
+        if (geometry.Contains(atomX[i], atomY[i]) && materialGrid[geometry.Index(atomX[i], atomY[i])] == -1) {
+            materialGrid[geometry.Index(atomX[i], atomY[i])] = i;
+        }
+    }
+
+    if (elementOrder != nullptr) {
+        for (int e = 0; e < NR_ELEMENT_COUNT; e++) {
+            atomElements.Reorder(e, elementOrder);
+            elementOrder += atomElements.Count(e);
+        }
+    }
+
+    // Water
+    memcpy(reactorWater.Temperatures(), reader.Data(waterSection), cells * sizeof(float));
+    reactorWater.Refresh();
+
+    // Neutrons
+    data = reader.Data(neutronSection);
+    uint64_t stride = Padded(count * sizeof(double));
+    neutrons.Assign(count, (const double*)data, (const double*)(data + stride), (const double*)(data + stride * 2),
+        (const double*)(data + stride * 3), data + stride * 4, weightSection != nullptr ? (const double*)reader.Data(weightSection) : nullptr);
+
+    // Flux field
+    if (fluxSection != nullptr) {
+        data = reader.Data(fluxSection);
+        memcpy(flux.Fast(), data, cells * sizeof(float));
+        memcpy(flux.Thermal(), data + Padded(cells * sizeof(float)), cells * sizeof(float));
+        flux.Refresh();
+        continuum = true;
+    }
+    UpdateNeutronCount();
+    UpdatePacketWeight();
+
+    // Rods
+    const checkpointRod* rods = (const checkpointRod*)reader.Data(rodSection);
+    const int32_t* banks = bankSection != nullptr ? (const int32_t*)reader.Data(bankSection) : nullptr;
+    int movable = 0;
+    for (uint64_t i = 0; i < rodSection->count; i++) {
+        int bank = -1;
+        if (banks != nullptr) {
+            bank = banks[i];
+        } else if (rods[i].moderator == 0) {
+            bank = movable++ % NR_ROD_BANKS;
+        }
+        AddControlRod(rods[i].xPosition, rods[i].height, rods[i].moderator != 0, bank);
+    }
+    // Bank settings as saved (a rod moved on its own does not follow its bank)
+    if (bankHeightSection != nullptr) {
+        const float* heights = (const float*)reader.Data(bankHeightSection);
+        for (int b = 0; b < bankHeightSection->count && b < rodBanks.size(); b++) {
+            bankHeight[b] = heights[b];
+        }
+    } else {
+        for (int b = 0; b < 5 && b < rodBanks.size(); b++) {
+            bankHeight[b] = state.rodHeight[b];
+        }
+    }
+
+    // Statistics (history length is kept, only the newest samples that fit are restored)
+    data = reader.Data(statSection);
+    const uint8_t* reactivity = data;
+    const int32_t* xenon = (const int32_t*)(data + Padded(history * reactivityBytes));
+    const float* temperature = (const float*)(data + Padded(history * reactivityBytes) + Padded(history * sizeof(int32_t)));
+    settings.stats.ZeroGraph();
+    uint64_t first = history > settings.stats.GetMax() ? history - settings.stats.GetMax() : 0;
+    for (uint64_t i = first; i < history; i++) {
+        settings.stats.AddReactionData(reactivityBytes == sizeof(int32_t) ? ((const int32_t*)reactivity)[i] : ((const int64_t*)reactivity)[i]);
+        settings.stats.AddXenonData(xenon[i]);
+        settings.stats.AddTempData(temperature[i]);
+    }
+    return true;
+}
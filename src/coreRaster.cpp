@@ -0,0 +1,134 @@
+#include "../include/coreRaster.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "../include/core.h"
+#include "../include/profiler.h"
+
+// Pack colour as R, G, B, A bytes in memory (GL_RGBA, GL_UNSIGNED_BYTE)
+static inline uint32_t Colour(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    uint8_t bytes[4] = { r, g, b, a };
+    uint32_t packed;
+    memcpy(&packed, bytes, sizeof(packed));
+    return packed;
+};
+
+// Texels per cell side
+int coreRaster::CellPixels(int sizeX, int sizeY)
+{
+    long long cells = std::max(1LL, (long long)sizeX * sizeY);
+    int k = std::sqrt((double)RR_RASTER_MAX_PIXELS / cells);
+    return std::max(1, std::min(RR_RASTER_CELL, k));
+};
+
+// Rasterize snapshot
+void coreRaster::Draw(const RenderSnapshot& frame, int cellPixels)
+{
+    NE_PROFILE_SCOPE("coreRaster::Draw");
+    width = frame.sizeX * cellPixels;
+    height = frame.sizeY * cellPixels;
+    scale = (float)cellPixels / RR_SCALE;
+    const int cells = frame.sizeX * frame.sizeY;
+    pixels.resize((size_t)width * height);
+
+    // Water, one block per cell (hotter is redder, out of range is left white)
+    // The encoder writes water row-major, so the cell comes from the index
+    const uint32_t white = Colour(255, 255, 255, 255);
+    if (frame.reactorWater.size() != cells) {
+        std::fill(pixels.begin(), pixels.end(), white);
+    }
+    const int rows = std::min<int>(frame.reactorWater.size(), cells) / frame.sizeX;
+    for (int y = 0; y < rows; y++) {
+        const RectangleData* water = &frame.reactorWater[(size_t)y * frame.sizeX];
+        uint32_t* row = &pixels[(size_t)y * cellPixels * width];
+        for (int x = 0; x < frame.sizeX; x++) {
+            int colourID = water[x].colourID;
+            uint32_t col = colourID == -1 ? white : Colour(colourID, 20, 255 - colourID, 255);
+            std::fill(row + x * cellPixels, row + (x + 1) * cellPixels, col);
+        }
+        // Repeat the first texel row down the block
+        for (int sub = 1; sub < cellPixels; sub++) {
+            std::copy(row, row + width, row + (size_t)sub * width);
+        }
+    }
+
+    // Reactor material, all atoms share one radius so the covered texels within a cell are found once
+    // At one or two texels per cell an atom would hide its water, so only U-235 and Xe-135 are drawn there
+    const bool smallCells = cellPixels < 3;
+    const uint32_t atomColours[3] = { Colour(200, 200, 200, 255), Colour(100, 200, 100, 255), Colour(50, 50, 50, 255) };
+    if (!frame.reactorMaterial.empty()) {
+        float centre = cellPixels / 2.0f;
+        float radius = std::max(frame.reactorMaterial[0].radius * scale, 0.5f);
+        int first = std::max(0, (int)std::ceil(centre - radius - 0.5f));
+        int last = std::min(cellPixels, (int)std::ceil(centre + radius - 0.5f));
+        const float toCell = 1.0f / RR_SCALE;
+        for (int i = 0; i < frame.reactorMaterial.size(); i++) {
+            const CircleData& atom = frame.reactorMaterial[i];
+            if (atom.colourID < 0 || atom.colourID > 2 || (smallCells && atom.colourID == 0)) {
+                continue;
+            }
+            int x = atom.position.x * toCell;
+            int y = atom.position.y * toCell;
+            if (x < 0 || x >= frame.sizeX || y < 0 || y >= frame.sizeY) {
+                continue;
+            }
+            uint32_t* block = &pixels[(size_t)y * cellPixels * width + x * cellPixels];
+            for (int row = first; row < last; row++) {
+                std::fill(block + (size_t)row * width + first, block + (size_t)row * width + last, atomColours[atom.colourID]);
+            }
+        }
+    }
+
+    // Neutrons (always at least one texel)
+    const uint32_t thermal = Colour(50, 50, 50, 255);
+    const uint32_t fast = Colour(100, 100, 100, 255);
+    for (int i = 0; i < frame.neutrons.size(); i++) {
+        const CircleData& neutron = frame.neutrons[i];
+        FillRect(neutron.position.x - neutron.radius, neutron.position.y - neutron.radius, neutron.position.x + neutron.radius, neutron.position.y + neutron.radius,
+            neutron.colourID == 1 ? fast : thermal, 1);
+    }
+
+    // Rods on top, at least one texel wide
+    for (int i = 0; i < frame.reactorRod.size(); i++) {
+        const RectangleData& rod = frame.reactorRod[i];
+        uint32_t col = thermal;
+        if (rod.colourID == 1) {
+            col = fast;
+        } else if (rod.colourID == -1) {
+            col = Colour(200, 200, 200, 255);
+        }
+        FillRect(rod.position.x - rod.size.x / 2, rod.position.y - rod.size.y / 2, rod.position.x + rod.size.x / 2, rod.position.y + rod.size.y / 2, col, 1);
+    }
+};
+
+// Fill texels with centres in [x0, x1) x [y0, y1)
+void coreRaster::FillRect(float x0, float y0, float x1, float y1, uint32_t colour, float minSize)
+{
+    x0 *= scale;
+    x1 *= scale;
+    y0 *= scale;
+    y1 *= scale;
+    if (x1 > x0 && x1 - x0 < minSize) {
+        float centre = (x0 + x1) / 2;
+        x0 = centre - minSize / 2;
+        x1 = centre + minSize / 2;
+    }
+    if (y1 > y0 && y1 - y0 < minSize) {
+        float centre = (y0 + y1) / 2;
+        y0 = centre - minSize / 2;
+        y1 = centre + minSize / 2;
+    }
+    int left = std::max(0, (int)std::ceil(x0 - 0.5f));
+    int right = std::min(width, (int)std::ceil(x1 - 0.5f));
+    int top = std::max(0, (int)std::ceil(y0 - 0.5f));
+    int bottom = std::min(height, (int)std::ceil(y1 - 0.5f));
+    if (left >= right) {
+        return;
+    }
+    for (int y = top; y < bottom; y++) {
+        std::fill(pixels.begin() + (size_t)y * width + left, pixels.begin() + (size_t)y * width + right, colour);
+    }
+};
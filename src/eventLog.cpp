@@ -0,0 +1,97 @@
+#include "../include/eventLog.h"
+
+#include <chrono>
+#include <cstring>
+
+// Start writer thread
+bool eventLog::Open(const std::string& path, int sizeX, int sizeY)
+{
+    Close();
+    if (sizeX - 1 > NR_EVENT_MAX_COORD || sizeY - 1 > NR_EVENT_MAX_COORD) {
+        printf("Event log: core too large for %d cell coordinates\n", NR_EVENT_MAX_COORD + 1);
+        return false;
+    }
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        printf("Event log: could not write %s\n", path.c_str());
+        return false;
+    }
+    eventLogHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, NR_EVENT_MAGIC, sizeof(header.magic));
+    header.version = NR_EVENT_VERSION;
+    header.sizeX = sizeX;
+    header.sizeY = sizeY;
+    fwrite(&header, sizeof(header), 1, file);
+
+    width = sizeX;
+    height = sizeY;
+    written = 0;
+    batch = new std::vector<eventRecord>();
+    batch->reserve(NR_EVENT_BATCH);
+    running.store(true, std::memory_order_release);
+    writer = std::thread(&eventLog::WriterLoop, this);
+    return true;
+};
+
+// Hand the partial batch over, then wait for the writer to finish
+void eventLog::Close()
+{
+    if (!running.load(std::memory_order_acquire)) {
+        return;
+    }
+    Submit();
+    running.store(false, std::memory_order_release);
+    writer.join();
+    delete batch;
+    batch = nullptr;
+    std::vector<eventRecord>* spare;
+    while (empty.TryPop(&spare)) {
+        delete spare;
+    }
+    fclose(file);
+    file = nullptr;
+};
+
+// Queue current batch and start a new one (never waits on the writer)
+void eventLog::Submit()
+{
+    if (batch->empty()) {
+        return;
+    }
+    std::vector<eventRecord>* next;
+    if (!empty.TryPop(&next)) {
+        next = new std::vector<eventRecord>();
+        next->reserve(NR_EVENT_BATCH);
+    }
+    while (!full.TryPush(batch)) {
+        // Writer is 64 batches behind, only now is it worth waiting
+        std::this_thread::yield();
+    }
+    batch = next;
+};
+
+// Write full batches until closed
+void eventLog::WriterLoop()
+{
+    std::vector<eventRecord>* done;
+    while (true) {
+        bool stopping = !running.load(std::memory_order_acquire);
+        bool any = false;
+        while (full.TryPop(&done)) {
+            fwrite(done->data(), sizeof(eventRecord), done->size(), file);
+            written.fetch_add(done->size(), std::memory_order_relaxed);
+            done->clear();
+            if (!empty.TryPush(done)) {
+                delete done;
+            }
+            any = true;
+        }
+        if (stopping) {
+            break;
+        }
+        if (!any) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+};
@@ -1,319 +1,1372 @@
 #include "../include/fluidEngine.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <limits>
 #include <vector>
 
 #include "../include/core.h"
-#include "../include/renderEngine.h"
+#include "../include/profiler.h"
+#include "../include/reactorData.h"
 #include "VectorMath.h"
-#include "imgui.h"
 
 fluidEngine::fluidEngine() {};
-fluidEngine::~fluidEngine() {};
-
-renderEngine* renderer;
-VM::Vector2 startingVelocity(0.0001, 0.0001);
-bool refreshNeutrons = false;
-int neutronCurrentID = 0;
-int statUpdate = NE_TARGET_TICKRATE;
+fluidEngine::~fluidEngine() { StopSimulation(); };
 
 // Spawn new reactor material
 void fluidEngine::AddReactorMaterial(int x, int y, int element)
 {
     atom mat = atom(x, y, element);
     reactorMaterial.push_back(mat);
+    atomElements.Add(reactorMaterial.size() - 1, element);
+    layoutVersion++;
+    // Index on lattice (first atom in a cell wins, matching scan order)
+    if (materialGrid.size() != geometry.Cells()) {
+        materialGrid.assign(geometry.Cells(), -1);
+    }
+    if (geometry.Contains(x, y) && materialGrid[geometry.Index(x, y)] == -1) {
+        materialGrid[geometry.Index(x, y)] = reactorMaterial.size() - 1;
+    }
 };
 
 // Spawn new water
 void fluidEngine::AddWater(int x, int y)
 {
-    water mat = water(x, y);
-    reactorWater.push_back(mat);
+    if (reactorWater.Size() != geometry.Cells()) {
+        reactorWater.Resize(geometry.sizeX, geometry.sizeY);
+    }
+    if (geometry.Contains(x, y)) {
+        reactorWater.Set(x, y, 0);
+    }
 };
 
 // Spawn new neutron
 void fluidEngine::AddNeutron(int x, int y, bool fast)
 {
-    neutron mat = neutron(x, y, neutronCurrentID, fast);
-    neutronCurrentID++;
-    VM::Vector2 acc = RandomUnitVector();
+    SpawnNeutron(x, y, fast, &rngUser);
+};
+
+// Spawn neutrons at random positions in the core
+void fluidEngine::SummonNeutrons(int count, bool fast)
+{
+    for (int i = 0; i < count; i++) {
+        double x = rngUser.Range(0, geometry.sizeX);
+        double y = rngUser.Range(0, geometry.sizeY);
+        SpawnNeutron(x, y, fast, &rngUser);
+    }
+};
+
+// Spawn weight neutrons in random directions using given stream (in continuum mode they join the flux field instead)
+// Under weighted transport they are split into packets of about packetWeight with their own directions,
+// or kept as one packet of packetWeight with chance weight / packetWeight
+void fluidEngine::SpawnNeutron(double x, double y, bool fast, rngStream* rng, double weight)
+{
+    if (continuum) {
+        // Into the nearest cell (neutrons that spawn outside the core are lost, as they would escape)
+        int cellX = std::floor(x + 0.5);
+        int cellY = std::floor(y + 0.5);
+        if (geometry.Contains(cellX, cellY)) {
+            flux.Add(geometry.Index(cellX, cellY), fast, weight);
+        }
+        return;
+    }
     float speed = settings.fissionNeutronSpeed;
     if (fast) {
         speed = settings.fissionFastNeutronSpeed;
     }
-    mat.velocity = VM::Vector2(acc.x * speed, acc.y * speed);
-    neutrons.push_back(mat);
+    double packets = weight / packetWeight;
+    if (packets >= 1) {
+        int split = std::min<long>(std::lround(packets), NE_PACKET_MAX_SPLIT);
+        for (int k = 0; k < split; k++) {
+            VM::Vector2 acc = rng->UnitVector();
+            neutrons.Spawn(x, y, acc.x * speed, acc.y * speed, fast, weight / split);
+        }
+    } else if (rng->Uniform() < packets) {
+        VM::Vector2 acc = rng->UnitVector();
+        neutrons.Spawn(x, y, acc.x * speed, acc.y * speed, fast, packetWeight);
+    }
 };
 
-// Spawn new control rod
-void fluidEngine::AddControlRod(int x, int h, bool moderator)
+// Spawn new control rod, optionally driven as part of a bank
+void fluidEngine::AddControlRod(float x, float h, bool moderator, int bank)
 {
-    controlRod mat = controlRod(x, h, moderator);
+    if (bank >= NR_MAX_ROD_BANKS) {
+        printf("Control rod bank %d out of range (max %d), rod is not driven\n", bank, NR_MAX_ROD_BANKS);
+        bank = -1;
+    }
+    bank = std::max(bank, -1);
+    controlRod mat = controlRod(x, h, moderator, bank);
     controlRods.push_back(mat);
+    if (bank >= 0) {
+        if (bank >= rodBanks.size()) {
+            rodBanks.resize(bank + 1);
+        }
+        rodBanks[bank].push_back(controlRods.size() - 1);
+        // Bank setting follows its newest rod, so nothing moves until the setting changes
+        bankHeight[bank] = h;
+        bankVersion++;
+    }
+    layoutVersion++;
+    rodVersion++;
 };
 
 // Initialise fluid engine
-void fluidEngine::Start(renderEngine* ren)
+void fluidEngine::Start()
 {
     printf("Fluid Engine Initialised\n");
-    renderer = ren;
+    // Seed independent streams
+    rngCore.Seed(settings.seed, 0);
+    rngTransport.Seed(settings.seed, 1);
+    rngDecay.Seed(settings.seed, 2);
+    rngHeat.Seed(settings.seed, 3);
+    rngUser.Seed(settings.seed, 4);
+    // Start transport workers
+    workers.Start(settings.workerThreads);
+    // Water cells a neutron can heat, relative to its nearest cell
+    // (any point within half a cell of the centre may be within range)
+    waterStencil.clear();
+    int reach = std::ceil(NR_WATER_RANGE + 0.5);
+    for (int dx = -reach; dx <= reach; dx++) {
+        for (int dy = -reach; dy <= reach; dy++) {
+            double gapX = std::max(std::abs(dx) - 0.5, 0.0);
+            double gapY = std::max(std::abs(dy) - 0.5, 0.0);
+            if (gapX * gapX + gapY * gapY < NR_WATER_RANGE * NR_WATER_RANGE) {
+                waterStencil.push_back(VM::Vector2Int(dx, dy));
+            }
+        }
+    }
+    // Share of a cell's neutrons in range of each offset, sampled over the cell (continuum heating and absorption)
+    const int samples = 16;
+    waterReach.assign(waterStencil.size(), 0);
+    for (int k = 0; k < waterStencil.size(); k++) {
+        int inRange = 0;
+        for (int sx = 0; sx < samples; sx++) {
+            for (int sy = 0; sy < samples; sy++) {
+                double gapX = waterStencil[k].x - ((sx + 0.5) / samples - 0.5);
+                double gapY = waterStencil[k].y - ((sy + 0.5) / samples - 0.5);
+                inRange += gapX * gapX + gapY * gapY < NR_WATER_RANGE * NR_WATER_RANGE;
+            }
+        }
+        waterReach[k] = (float)inRange / (samples * samples);
+    }
+};
+
+// Change core size (clears the core, call before GenerateReactor)
+void fluidEngine::SetGeometry(ReactorGeometry newGeometry)
+{
+    geometry = newGeometry;
+    reactorMaterial.clear();
+    atomElements.Clear();
+    regenTick.clear();
+    materialGrid.assign(geometry.Cells(), -1);
+    reactorWater.Resize(geometry.sizeX, geometry.sizeY);
+    controlRods.clear();
+    rodBanks.clear();
+    bankVersion++;
+    neutrons.Clear();
+    flux.Resize(geometry.sizeX, geometry.sizeY);
+    continuum = false;
+    layoutVersion++;
+    rodVersion++;
+};
+
+// Spawn initial reactor (water, reactor material and control rods)
+void fluidEngine::GenerateReactor(float enrichment)
+{
+    // Spawn core
+    for (int x = 0; x < geometry.sizeX; x++) {
+        for (int y = 0; y < geometry.sizeY; y++) {
+            AddWater(x, y);
+            if (rngCore.Range(0, 1.0) < enrichment) {
+                AddReactorMaterial(x, y, 1);
+            } else {
+                AddReactorMaterial(x, y, 0);
+            }
+        }
+    }
+
+    // Spawn rods, alternating static moderators and movable control rods
+    // Movable rods are dealt into NR_ROD_BANKS banks from left to right
+    int movable = 0;
+    for (int x = 0; x <= geometry.sizeX; x += NR_ROD_SPACING) {
+        if ((x / NR_ROD_SPACING) % 2 == 0) {
+            AddControlRod(x, 0, true); // Static
+        } else {
+            AddControlRod(x, 100, false, movable++ % NR_ROD_BANKS);
+        }
+    }
 };
 
+// Number of atoms of element in reactor
+int fluidEngine::GetElementCount(int element)
+{
+    return atomElements.Count(element);
+}
+
 // Count xenon atoms in reactor
 int fluidEngine::GetXenonCount()
 {
-    int sum = 0;
-    for (int i = 0; i < reactorMaterial.size(); i++) {
-        if (reactorMaterial[i].element == 2) {
-            sum++;
+    return GetElementCount(2);
+}
+
+// Round a summed weight (neutrons, fissions) to a count, saturating instead of overflowing int64_t
+static int64_t WholeNeutrons(double n)
+{
+    if (!(n < 9e18)) {
+        return n > 0 ? (int64_t)9e18 : 0;
+    }
+    return std::llround(n);
+}
+
+// Live fast neutrons (packet weights summed)
+int64_t fluidEngine::GetFastNeutronCount()
+{
+    return WholeNeutrons(continuum ? flux.FastSum() : neutrons.FastWeight());
+}
+
+// Live thermal neutrons
+int64_t fluidEngine::GetThermalNeutronCount()
+{
+    return neutronCount - GetFastNeutronCount();
+}
+
+// Neutron packets being tracked (same as neutronCount unless weighted transport is on, 0 in continuum mode)
+int fluidEngine::GetPacketCount()
+{
+    return neutrons.Size();
+}
+
+// Move all neutrons of one chunk
+// Runs on worker threads, so only writes neutron i and this chunk's buffer
+// SizeX/SizeY fix the core size at compile time (0 = use runtime geometry)
+template <int SizeX, int SizeY>
+void fluidEngine::TransportChunk(int chunk)
+{
+    NE_PROFILE_SCOPE("TransportChunk");
+    transportBuffer* buffer = &transportBuffers[chunk];
+    buffer->contacts.clear();
+    buffer->kills.clear();
+    buffer->escapes.clear();
+    buffer->moderated = 0;
+    int end = std::min(neutrons.Size(), (chunk + 1) * NE_TRANSPORT_CHUNK);
+    const bool traversal = settings.transportMode == TRANSPORT_TRAVERSAL;
+    for (int i = chunk * NE_TRANSPORT_CHUNK; i < end; i++) {
+        if (neutrons.IsDead(i)) {
+            continue;
+        }
+        if (traversal) {
+            TraversalUpdate<SizeX, SizeY>(i, buffer);
+            continue;
         }
+        if (CollisionUpdate<SizeX, SizeY>(i, buffer)) {
+            continue;
+        }
+        if (ContainerUpdate<SizeX, SizeY>(i, buffer)) {
+            continue;
+        }
+        PositionUpdate(i);
     }
-    return sum;
 }
 
-// Do collision check on all particles
-void fluidEngine::CollisionUpdate(neutron* particle)
+// Do collision check on all particles (returns true if absorbed)
+template <int SizeX, int SizeY>
+bool fluidEngine::CollisionUpdate(int i, transportBuffer* buffer)
 {
+    const int sizeX = fixedGeometry<SizeX, SizeY>::X(geometry);
+    const int sizeY = fixedGeometry<SizeX, SizeY>::Y(geometry);
+    VM::Vector2 position(neutrons.posX[i], neutrons.posY[i]);
     // Check for reactor material collisions
-    for (int j = 0; j < reactorMaterial.size(); j++) {
+    // Atoms sit on integer lattice points 1 apart, so only the nearest one can be within min_dist
+    int cellX = std::floor(position.x + 0.5);
+    int cellY = std::floor(position.y + 0.5);
+    int j = -1;
+    if (cellX >= 0 && cellX < sizeX && cellY >= 0 && cellY < sizeY) {
+        j = materialGrid[cellX + cellY * sizeX];
+    }
+    if (j != -1) {
         double dist;
-        VectorDistanceInt(&reactorMaterial[j].position, &particle->position, &dist);
+        VectorDistanceInt(&reactorMaterial[j].position, &position, &dist);
         const double min_dist = 0.5;
         if (dist < min_dist) {
-            if (!particle->fast) {
+            if (!neutrons.fast[i]) {
                 // Thermal Neutrons only collide with reactor material
-                if (reactorMaterial[j].element == 1) {
-                    // Is U-235 -> Can Fission!
-                    reactorMaterial[j].element = 0;
-                    DestroyNeutron(particle->id);
-                    RegenInert();
-                    for (int i = 0; i < settings.fissionNeutronCount; i++) {
-                        AddNeutron(reactorMaterial[j].position.x, reactorMaterial[j].position.y, true);
-                    }
-                    isPlayingSound = true;
-                    break;
-                } else if (reactorMaterial[j].element == 2) {
-                    // Is Xe-135 -> Can Stabilise!
-                    reactorMaterial[j].element = 0;
-                    DestroyNeutron(particle->id);
-                    break;
-                } else {
-                    continue;
-                }
+                // Element may still change this tick, so resolve in order after transport
+                buffer->contacts.push_back({ i, j });
             }
         }
     }
     // Check for control rod collisions
-    // Absorb both fast and slow neutrons
-    for (int j = 0; j < controlRods.size(); j++) {
-        // Check x
-        if (particle->position.x + 0.5 > (controlRods[j].xPosition - 0.5) && particle->position.x + 0.5 < (controlRods[j].xPosition + 0.5)) {
-            // Check y
-            if (particle->position.y + 0.5 < ((controlRods[j].height / 100) * NR_SIZE_Y)) {
-                // In bounds
-
-                // Standard Control Rod
-                DestroyNeutron(particle->id);
-                break;
-
-                /*  if (!controlRods[j].moderator) {
-                     // Standard Control Rod
-                     DestroyNeutron(particle->id);
-                     break;
-                 } else {
-                     // Moderator
-                     if (particle->fast) {
-
-                         particle->velocity.x = -particle->velocity.x; // Reflect off moderator
-                         VM::VectorNormalise(&particle->velocity); // Normalise velocity vector
-                         VM::VectorScalarMultiply(&particle->velocity, &particle->velocity, settings.fissionNeutronSpeed); // Scalar multiply by new speed
-                         particle->fast = false; // No longer fast neutron
-                     }
-                 } */
-            } else if (particle->position.y + 0.5 > (((controlRods[j].height / 100)) * NR_SIZE_Y) + RR_CR_PADDING) {
-                // Moderator
-                if (particle->fast) {
-
-                    particle->velocity.x = -particle->velocity.x; // Reflect off moderator
-                    VM::VectorNormalise(&particle->velocity); // Normalise velocity vector
-                    VM::VectorScalarMultiply(&particle->velocity, &particle->velocity, settings.fissionNeutronSpeed); // Scalar multiply by new speed
-                    particle->fast = false; // No longer fast neutron
+    // Absorb both fast and slow neutrons below the tip, moderate fast neutrons above tip + padding
+    const rodColumn& rod = rodColumns.At(position.x);
+    if (position.y + 0.5 < rod.absorberTip) {
+        buffer->kills.push_back(i);
+        return true;
+    }
+    if (neutrons.fast[i] && position.y + 0.5 > rod.moderatorTip + RR_CR_PADDING) {
+        VM::Vector2 velocity(-neutrons.velX[i], neutrons.velY[i]); // Reflect off moderator
+        VM::VectorNormalise(&velocity); // Normalise velocity vector
+        VM::VectorScalarMultiply(&velocity, &velocity, settings.fissionNeutronSpeed); // Scalar multiply by new speed
+        neutrons.velX[i] = velocity.x;
+        neutrons.velY[i] = velocity.y;
+        neutrons.fast[i] = false; // No longer fast neutron
+        buffer->moderated += neutrons.weight[i];
+    }
+    return false;
+}
+
+// Resolve thermal neutron i touching atom j
+void fluidEngine::ReactionUpdate(int i, int j)
+{
+    if (reactorMaterial[j].element == 1) {
+        // Is U-235 -> Can Fission!
+        double weight;
+        if (neutrons.weight[i] > 1 && j < regenTick.size() && regenTick[j] == tickCount) {
+            // Regenerated this tick under the packet: one of its neutrons finds the atom, the rest fly on
+            neutrons.SetWeight(i, neutrons.weight[i] - 1);
+            weight = 1;
+        } else {
+            weight = TakeNeutron(i);
+        }
+        if (weight == 0) {
+            return;
+        }
+        // A packet splits as many atoms as it holds neutrons (in expectation): this one, then the U-235 atoms nearest it
+        NearestAtoms(j, 1, PacketAtoms(weight), &packetAtoms);
+        for (int k : packetAtoms) {
+            SetElement(k, 0);
+            if (events.IsOpen()) {
+                events.Record(EVENT_FISSION, tickCount + 1, reactorMaterial[k].position.x, reactorMaterial[k].position.y, neutrons.fast[i]);
+            }
+            RegenInert();
+        }
+        for (int k = 0; k < settings.fissionNeutronCount; k++) {
+            SpawnNeutron(reactorMaterial[j].position.x, reactorMaterial[j].position.y, true, &rngTransport, weight);
+        }
+        fissionCount += weight;
+        isPlayingSound = true;
+    } else if (reactorMaterial[j].element == 2) {
+        // Is Xe-135 -> Can Stabilise!
+        double weight = TakeNeutron(i);
+        if (weight == 0) {
+            return;
+        }
+        // As many xenon atoms as the packet holds neutrons: this one, then the xenon atoms nearest it
+        NearestAtoms(j, 2, PacketAtoms(weight), &packetAtoms);
+        for (int k : packetAtoms) {
+            SetElement(k, 0);
+            if (events.IsOpen()) {
+                events.Record(EVENT_XENON_ABSORPTION, tickCount + 1, reactorMaterial[k].position.x, reactorMaterial[k].position.y, neutrons.fast[i]);
+            }
+        }
+    }
+}
+
+// Atom j and up to count - 1 more atoms of its element, nearest first (square rings of lattice cells)
+// The search stops at twice the radius that holds count such atoms on average, so a sparse element cannot scan the whole core
+void fluidEngine::NearestAtoms(int j, int element, int count, std::vector<int>* out)
+{
+    out->clear();
+    out->push_back(j);
+    if (count <= 1) {
+        return;
+    }
+    double density = (double)atomElements.Count(element) / reactorMaterial.size();
+    int reach = 2 * (int)std::ceil(std::sqrt(count / std::max(density, 1e-9)) / 2) + 1;
+    int x0 = reactorMaterial[j].position.x;
+    int y0 = reactorMaterial[j].position.y;
+    for (int d = 1; d <= reach && out->size() < count; d++) {
+        for (int y = y0 - d; y <= y0 + d && out->size() < count; y++) {
+            int step = (y == y0 - d || y == y0 + d) ? 1 : 2 * d;
+            for (int x = x0 - d; x <= x0 + d && out->size() < count; x += step) {
+                if (!geometry.Contains(x, y)) {
+                    continue;
+                }
+                int k = materialGrid[geometry.Index(x, y)];
+                if (k != -1 && reactorMaterial[k].element == element) {
+                    out->push_back(k);
                 }
             }
         }
     }
 }
 
-// Apply physics to neutrons
-void fluidEngine::PositionUpdate(neutron* particle)
+// Atoms a reaction of weight neutrons changes, floor(weight) and one more with chance of the remainder
+// (never more than the core holds, however heavy the packet)
+int fluidEngine::PacketAtoms(double weight)
 {
-    VM::Vector2 temp(0, 0);
+    if (weight >= reactorMaterial.size()) {
+        return reactorMaterial.size();
+    }
+    int atoms = (int)weight;
+    if (weight > atoms && rngTransport.Uniform() < weight - atoms) {
+        atoms++;
+    }
+    return atoms;
+}
+
+// Use up packet i in a reaction, returns the neutrons it reacts as (0 if it misses)
+// A packet lighter than 1 reacts with chance of its weight as one neutron, so atoms change at the physical rate,
+// a heavier one reacts as a whole so the reaction rate per neutron does not fall as packets grow
+double fluidEngine::TakeNeutron(int i)
+{
+    double w = neutrons.weight[i];
+    DestroyNeutron(i);
+    if (w >= 1) {
+        return w;
+    }
+    return rngTransport.Uniform() < w ? 1 : 0;
+}
 
-    VM::VectorScalarMultiply(&temp, &particle->velocity,
-        NE_DELTATIME);
+// Log neutron i at its nearest cell (tick numbers match telemetry)
+void fluidEngine::RecordNeutronEvent(eventType type, int i)
+{
+    events.Record(type, tickCount + 1, std::floor(neutrons.posX[i] + 0.5), std::floor(neutrons.posY[i] + 0.5), neutrons.fast[i]);
+}
 
-    VM::VectorSum(&particle->position, &particle->position,
-        &temp);
+// Apply physics to neutrons
+void fluidEngine::PositionUpdate(int i)
+{
+    neutrons.posX[i] += neutrons.velX[i] * NE_DELTATIME;
+    neutrons.posY[i] += neutrons.velY[i] * NE_DELTATIME;
 };
 
-// Inert atoms radiate random neutrons
-void fluidEngine::DecayUpdate(atom* particle)
+// Inert atoms radiate random neutrons and decay to xenon
+// Every atom is an independent trial with a fixed chance per tick, so the gap to the next hit atom is geometric:
+// skip straight to it and only touch atoms that are hit (a hit on a non-inert atom does nothing, as before)
+void fluidEngine::DecayUpdate()
 {
-    if (particle->element == 0) {
-        // Inert -> Release radiation
-        if (RandomRange(0.0, 1.0) < settings.decayChance * NE_DELTATIME) {
-            // if (RandomRange(0.0, 1.0) < 0.0064 * settings.decayChance * neutronCount * NE_DELTATIME) {
-            AddNeutron(particle->position.x, particle->position.y, true);
+    const long long atoms = reactorMaterial.size();
+    // Inert -> Release radiation (leaves elements alone, so it can run ahead of xenon decay)
+    double emitChance = std::min(settings.decayChance * NE_DELTATIME, 1.0);
+    if (emitChance > 0) {
+        double logMiss = std::log1p(-emitChance);
+        for (long long i = rngDecay.Geometric(logMiss); i < atoms; i += 1 + rngDecay.Geometric(logMiss)) {
+            if (reactorMaterial[i].element == 0) {
+                SpawnNeutron(reactorMaterial[i].position.x, reactorMaterial[i].position.y, true, &rngDecay);
+            }
         }
-        // Inert -> Can decay to Xenon
-        if (RandomRange(0.0, 1.0) < settings.xenonDecayChance * NE_DELTATIME) {
-            particle->element = 2;
+    }
+    // Inert -> Can decay to Xenon
+    double xenonChance = std::min(settings.xenonDecayChance * NE_DELTATIME, 1.0);
+    if (xenonChance > 0) {
+        double logMiss = std::log1p(-xenonChance);
+        for (long long i = rngDecay.Geometric(logMiss); i < atoms; i += 1 + rngDecay.Geometric(logMiss)) {
+            if (reactorMaterial[i].element == 0) {
+                SetElement(i, 2);
+            }
         }
     }
 };
 
-// Regen random inert atom
-void fluidEngine::RegenInert()
+// Regen random inert atom (returns it, -1 if none are inert)
+int fluidEngine::RegenInert()
 {
-    bool regenerated = false;
-    while (!regenerated) {
-        int test = RandomRangeInt(0, reactorMaterial.size());
-        if (reactorMaterial[test].element == 0) {
-            reactorMaterial[test].element = 1;
-            regenerated = true;
-        }
+    int inert = atomElements.Count(0);
+    if (inert == 0) {
+        return -1;
+    }
+    int j = atomElements.At(0, rngTransport.RangeInt(0, inert - 1));
+    SetElement(j, 1);
+    if (regenTick.size() < reactorMaterial.size()) {
+        regenTick.resize(reactorMaterial.size(), -1);
     }
+    regenTick[j] = tickCount;
+    return j;
 };
 
-// Heat water if neutron is touching
-void fluidEngine::HeatTransferUpdate(water* particle)
+// Heat water touched by neutrons, then advance the water grid
+void fluidEngine::HeatTransferUpdate()
 {
-    if (particle->temperature > 0) {
-        particle->temperature -= settings.heatDissipate * NE_DELTATIME;
-    } else {
-        particle->temperature = 0;
+    NE_PROFILE_SCOPE("HeatTransferUpdate");
+    const float* temperature = reactorWater.Temperatures();
+    waterHeat.assign(reactorWater.Size(), 0);
+    if (continuum) {
+        // Each cell's flux heats the cells in range by its expected reach (absorption was taken in FluxUpdate)
+        const float* fast = flux.Fast();
+        const float* thermal = flux.Thermal();
+        for (int y = 0; y < geometry.sizeY; y++) {
+            for (int x = 0; x < geometry.sizeX; x++) {
+                float heat = 0;
+                for (int k = 0; k < waterStencil.size(); k++) {
+                    int sourceX = x - waterStencil[k].x;
+                    int sourceY = y - waterStencil[k].y;
+                    if (geometry.Contains(sourceX, sourceY)) {
+                        int i = geometry.Index(sourceX, sourceY);
+                        heat += waterReach[k] * (fast[i] + thermal[i]);
+                    }
+                }
+                waterHeat[geometry.Index(x, y)] = heat * settings.heatTransfer * NE_DELTATIME;
+            }
+        }
     }
-    for (int j = 0; j < neutrons.size(); j++) {
-        double dist;
-        VectorDistanceInt(&particle->position, &neutrons[j].position, &dist);
+    // Each neutron scatters into the few cells in range
+    for (int j = 0; j < neutrons.Size(); j++) {
+        if (neutrons.IsDead(j)) {
+            continue;
+        }
+        VM::Vector2 position(neutrons.posX[j], neutrons.posY[j]);
+        int nearestX = std::floor(position.x + 0.5);
+        int nearestY = std::floor(position.y + 0.5);
+        bool absorbed = false;
+        for (int k = 0; k < waterStencil.size(); k++) {
+            VM::Vector2Int cell(nearestX + waterStencil[k].x, nearestY + waterStencil[k].y);
+            if (cell.x < 0 || cell.x >= reactorWater.Width() || cell.y < 0 || cell.y >= reactorWater.Height()) {
+                continue;
+            }
+            double dist;
+            VectorDistanceInt(&cell, &position, &dist);
 
-        if (dist < NR_WATER_RANGE) {
-            particle->temperature += settings.heatTransfer * NE_DELTATIME;
-            if (particle->temperature < 100) {
-                if (RandomRange(0.0, 1.0) < settings.waterAbsorptionChance * NE_DELTATIME) {
-                    DestroyNeutron(neutrons[j].id);
+            if (dist < NR_WATER_RANGE) {
+                int i = cell.x + cell.y * reactorWater.Width();
+                waterHeat[i] += settings.heatTransfer * NE_DELTATIME * neutrons.weight[j];
+                if (!absorbed && temperature[i] + waterHeat[i] < 100) {
+                    // Same chance per neutron-cell pair as before
+                    if (rngHeat.Uniform() < settings.waterAbsorptionChance * NE_DELTATIME) {
+                        DestroyNeutron(j);
+                        absorbed = true;
+                        if (events.IsOpen()) {
+                            events.Record(EVENT_WATER_ABSORPTION, tickCount + 1, cell.x, cell.y, neutrons.fast[j]);
+                        }
+                    }
                 }
             }
-        } else {
-            continue;
         }
     }
-    if (particle->position.y == NR_SIZE_Y - 1) {
-        particle->temperature = NR_WATER_TEMP_OFFSET;
-    }
-    if (particle->position.y != 0) {
-        int val = (particle->position.y - 1) + ((particle->position.x) * NR_SIZE_Y); // Id of water packet above
-        float delta = (particle->temperature - reactorWater[val].temperature) * NE_DELTATIME * settings.waterFlow;
-        reactorWater[val].temperature += delta;
-        particle->temperature -= delta;
-    }
+    // Dissipation, upward flow and inlet (bottom row) on the whole grid
+    reactorWater.Step(waterHeat.data(), settings.heatDissipate * NE_DELTATIME, settings.waterFlow * NE_DELTATIME, NR_WATER_TEMP_OFFSET, &workers);
 };
 
-// Remove neutrons out of containment
-void fluidEngine::ContainerUpdate(neutron* particle)
+// Remove neutrons out of containment (returns true if escaped)
+template <int SizeX, int SizeY>
+bool fluidEngine::ContainerUpdate(int i, transportBuffer* buffer)
 {
     bool escaped = false;
     float alter = 0.5;
-    if (particle->position.x + alter < 0) {
+    if (neutrons.posX[i] + alter < 0) {
         escaped = true;
     }
-    if (particle->position.x + alter > NR_SIZE_X) {
+    if (neutrons.posX[i] + alter > fixedGeometry<SizeX, SizeY>::X(geometry)) {
         escaped = true;
     }
-    if (particle->position.y + alter < 0) {
+    if (neutrons.posY[i] + alter < 0) {
         escaped = true;
     }
-    if (particle->position.y + alter > NR_SIZE_Y) {
+    if (neutrons.posY[i] + alter > fixedGeometry<SizeX, SizeY>::Y(geometry)) {
         escaped = true;
     }
 
     if (escaped) {
-        DestroyNeutron(particle->id);
+        buffer->escapes.push_back(i);
     }
+    return escaped;
 };
 
-// Clear all neutrons
-void fluidEngine::ClearNeutrons()
+// Narrow [t0, t1] to where start + delta * t lies strictly inside (lo, hi)
+// Returns false if nothing of positive length is left
+static bool ClipLeg(double start, double delta, double lo, double hi, double* t0, double* t1)
 {
-    neutrons.clear();
-    refreshNeutrons = true;
+    if (delta == 0) {
+        return start > lo && start < hi && *t0 < *t1;
+    }
+    double a = (lo - start) / delta;
+    double b = (hi - start) / delta;
+    if (a > b) {
+        std::swap(a, b);
+    }
+    *t0 = std::max(*t0, a);
+    *t1 = std::min(*t1, b);
+    return *t0 < *t1;
 };
 
-// Destroy specific neutron
-void fluidEngine::DestroyNeutron(int id)
+enum traversalEvent {
+    TRAVERSAL_NONE = 0,
+    TRAVERSAL_ESCAPE,
+    TRAVERSAL_ROD,
+    TRAVERSAL_MODERATOR,
+    TRAVERSAL_CONTACT
+};
+
+// Move neutron i along its whole path for this tick, stopping at the first thing it meets
+// Atoms are only tested in the lattice cells the path crosses (DDA walk) and rods only in the columns it spans,
+// so fast neutrons cannot tunnel and the cost grows with the cells crossed, not with a smaller timestep
+// Returns true if absorbed by a rod or escaped
+template <int SizeX, int SizeY>
+bool fluidEngine::TraversalUpdate(int i, transportBuffer* buffer)
 {
-    for (int i = 0; i < neutrons.size(); i++) {
-        if (neutrons[i].id == id) {
-            neutrons.erase(neutrons.begin() + i);
+    const int sizeX = fixedGeometry<SizeX, SizeY>::X(geometry);
+    const int sizeY = fixedGeometry<SizeX, SizeY>::Y(geometry);
+    const double infinity = std::numeric_limits<double>::infinity();
+    // Cell (x, y) spans [x - 0.5, x + 0.5) around its atom, so walk in offset coordinates where cells are [x, x + 1)
+    double u = neutrons.posX[i] + 0.5;
+    double v = neutrons.posY[i] + 0.5;
+    double remaining = NE_DELTATIME;
+    // Moderation turns a neutron thermal, so a path has at most two legs
+    while (remaining > 0) {
+        double du = neutrons.velX[i] * remaining;
+        double dv = neutrons.velY[i] * remaining;
+        // Earliest event, as a fraction of this leg
+        double hit = 1;
+        traversalEvent event = TRAVERSAL_NONE;
+        int atom = -1;
+
+        // Leaving the core (already outside counts as leaving now)
+        double exitStart = 0;
+        double exit = 1;
+        if (u < 0 || u > sizeX || v < 0 || v > sizeY || !ClipLeg(u, du, 0, sizeX, &exitStart, &exit) || !ClipLeg(v, dv, 0, sizeY, &exitStart, &exit)) {
+            exit = 0;
+        }
+        if (exit < hit) {
+            hit = exit;
+            event = TRAVERSAL_ESCAPE;
+        }
+
+        // Rod columns spanned by the leg: absorb below the tip, moderate fast neutrons above tip + padding
+        double uMin = std::min(u, u + du);
+        double uMax = std::max(u, u + du);
+        int firstColumn = std::max((int)std::floor(uMin - 0.5), rodColumns.First());
+        int lastColumn = std::min((int)std::ceil(uMax + 0.5), rodColumns.Last());
+        for (int k = firstColumn; k <= lastColumn; k++) {
+            const rodColumn& rod = rodColumns.Column(k);
+            double column = k;
+            if (rodColumns.Empty(rod) || column + 0.5 <= uMin || column - 0.5 >= uMax) {
+                continue;
+            }
+            double in = 0;
+            double out = hit;
+            if (!ClipLeg(u, du, column - 0.5, column + 0.5, &in, &out)) {
+                continue;
+            }
+            double tip = rod.absorberTip;
+            double t0 = in;
+            double t1 = out;
+            if (ClipLeg(v, dv, -infinity, tip, &t0, &t1)) {
+                hit = t0;
+                event = TRAVERSAL_ROD;
+            }
+            if (neutrons.fast[i]) {
+                t0 = in;
+                t1 = std::min(out, hit);
+                if (ClipLeg(v, dv, (double)rod.moderatorTip + RR_CR_PADDING, infinity, &t0, &t1)) {
+                    hit = t0;
+                    event = TRAVERSAL_MODERATOR;
+                }
+            }
+        }
+
+        // Thermal neutrons touch fissile or xenon atoms in the cells they cross
+        // Each atom's radius fits inside its cell, so testing cell by cell is exact
+        if (!neutrons.fast[i]) {
+            int cellX = std::floor(u);
+            int cellY = std::floor(v);
+            int stepX = du > 0 ? 1 : -1;
+            int stepY = dv > 0 ? 1 : -1;
+            double nextX = du != 0 ? ((du > 0 ? cellX + 1 : cellX) - u) / du : infinity;
+            double nextY = dv != 0 ? ((dv > 0 ? cellY + 1 : cellY) - v) / dv : infinity;
+            double deltaX = du != 0 ? std::abs(1 / du) : infinity;
+            double deltaY = dv != 0 ? std::abs(1 / dv) : infinity;
+            double enter = 0;
+            while (enter < hit) {
+                double leave = std::min(std::min(nextX, nextY), hit);
+                if (cellX >= 0 && cellX < sizeX && cellY >= 0 && cellY < sizeY) {
+                    int j = materialGrid[cellX + cellY * sizeX];
+                    if (j != -1 && reactorMaterial[j].element != 0) {
+                        // First t in [enter, leave] within 0.5 of the atom
+                        double ox = u - (reactorMaterial[j].position.x + 0.5);
+                        double oy = v - (reactorMaterial[j].position.y + 0.5);
+                        double a = du * du + dv * dv;
+                        double b = 2 * (ox * du + oy * dv);
+                        double c = ox * ox + oy * oy - 0.25;
+                        double touch = infinity;
+                        double ex = ox + du * enter;
+                        double ey = oy + dv * enter;
+                        if (ex * ex + ey * ey < 0.25) {
+                            touch = enter;
+                        } else if (a > 0) {
+                            double disc = b * b - 4 * a * c;
+                            if (disc > 0) {
+                                double first = (-b - std::sqrt(disc)) / (2 * a);
+                                if (first >= enter) {
+                                    touch = first;
+                                }
+                            }
+                        }
+                        if (touch <= leave && touch < hit) {
+                            hit = touch;
+                            event = TRAVERSAL_CONTACT;
+                            atom = j;
+                            break;
+                        }
+                    }
+                }
+                if (nextX < nextY) {
+                    enter = nextX;
+                    nextX += deltaX;
+                    cellX += stepX;
+                } else {
+                    enter = nextY;
+                    nextY += deltaY;
+                    cellY += stepY;
+                }
+            }
+        }
+
+        // Advance to the event
+        u += du * hit;
+        v += dv * hit;
+        neutrons.posX[i] = u - 0.5;
+        neutrons.posY[i] = v - 0.5;
+        remaining *= 1 - hit;
+        switch (event) {
+        case TRAVERSAL_ESCAPE:
+            buffer->escapes.push_back(i);
+            return true;
+        case TRAVERSAL_ROD:
+            buffer->kills.push_back(i);
+            return true;
+        case TRAVERSAL_MODERATOR: {
+            VM::Vector2 velocity(-neutrons.velX[i], neutrons.velY[i]); // Reflect off moderator
+            VM::VectorNormalise(&velocity);
+            VM::VectorScalarMultiply(&velocity, &velocity, settings.fissionNeutronSpeed);
+            neutrons.velX[i] = velocity.x;
+            neutrons.velY[i] = velocity.y;
+            neutrons.fast[i] = false;
+            buffer->moderated += neutrons.weight[i];
             break;
         }
+        case TRAVERSAL_CONTACT:
+            // Element may still change this tick, so resolve in order after transport
+            // The neutron waits at the atom for the rest of the tick
+            buffer->contacts.push_back({ i, atom });
+            return false;
+        default:
+            return false;
+        }
     }
-    refreshNeutrons = true;
+    return false;
+};
+
+// Clear all neutrons
+void fluidEngine::ClearNeutrons()
+{
+    neutrons.Clear();
+    flux.Clear();
+};
+
+// Ask the simulation thread to summon neutrons
+void fluidEngine::RequestNeutrons(int count)
+{
+    requestedNeutrons += count;
+};
+
+// Ask the simulation thread to clear all neutrons
+void fluidEngine::RequestClearNeutrons()
+{
+    requestedClear = true;
+};
+
+// Ask the simulation thread to save a checkpoint
+void fluidEngine::RequestSave(const std::string& path)
+{
+    std::lock_guard<std::mutex> guard(requestLock);
+    requestedSave = path;
+};
+
+// Ask the simulation thread to load a checkpoint
+void fluidEngine::RequestLoad(const std::string& path)
+{
+    std::lock_guard<std::mutex> guard(requestLock);
+    requestedLoad = path;
+};
+
+// Ask the simulation thread to move rod banks
+void fluidEngine::RequestBankHeights(const float* heights, int banks, uint64_t version)
+{
+    std::lock_guard<std::mutex> guard(requestLock);
+    requestedBanks = std::min(std::max(banks, 0), NR_MAX_ROD_BANKS);
+    std::copy(heights, heights + requestedBanks, requestedBankHeight);
+    requestedBankVersion = version;
+};
+
+// Destroy specific neutron (removed at end of tick)
+void fluidEngine::DestroyNeutron(int i)
+{
+    neutrons.Kill(i);
 };
 
 // Set control rod height
-void fluidEngine::SetControlRodHeight(int id, int h)
+void fluidEngine::SetControlRodHeight(int id, float h)
+{
+    if (id < 0 || id >= controlRods.size()) {
+        return;
+    }
+    if (controlRods[id].height != h) {
+        controlRods[id].height = h;
+        rodVersion++;
+    }
+};
+
+// Move every rod of a bank
+void fluidEngine::MoveBank(int bank, float h)
+{
+    if (bank < 0 || bank >= rodBanks.size()) {
+        return;
+    }
+    for (int id : rodBanks[bank]) {
+        SetControlRodHeight(id, h);
+    }
+    bankHeight[bank] = h;
+};
+
+// Move every rod of a bank, overriding pending UI requests
+void fluidEngine::SetBankHeight(int bank, float h)
+{
+    MoveBank(bank, h);
+    bankVersion++;
+};
+
+// Insertion a bank is set to
+float fluidEngine::BankHeight(int bank)
+{
+    if (bank < 0 || bank >= rodBanks.size()) {
+        return 0;
+    }
+    return bankHeight[bank];
+};
+
+// Apply the UI's bank request, then refresh the rod columns if any rod moved
+void fluidEngine::ApplyRodBanks()
 {
-    controlRods[id].height = h;
+    {
+        std::lock_guard<std::mutex> guard(requestLock);
+        // A request based on older banks (before a load or a new core) would undo their settings
+        if (requestedBankVersion == bankVersion) {
+            for (int b = 0; b < requestedBanks && b < rodBanks.size(); b++) {
+                if (requestedBankHeight[b] != bankHeight[b]) {
+                    MoveBank(b, requestedBankHeight[b]);
+                }
+            }
+        }
+        requestedBanks = 0;
+    }
+    if (rodTableVersion != rodVersion) {
+        rodColumns.Build(controlRods, geometry.sizeX, geometry.sizeY);
+        rodTableVersion = rodVersion;
+    }
 };
 
-// Calculate average water temperature in reactor
+// Change element of atom j (journaled so snapshots only re-encode changed atoms)
+void fluidEngine::SetElement(int j, int element)
+{
+    if (reactorMaterial[j].element == element) {
+        return;
+    }
+    atomElements.Move(j, reactorMaterial[j].element, element);
+    reactorMaterial[j].element = element;
+    atomChanges.push_back(j);
+    // Bound the journal, slots encoded before the dropped half fall back to a full encode
+    if (atomChanges.size() > NE_CHANGE_JOURNAL) {
+        int dropped = atomChanges.size() / 2;
+        atomChanges.erase(atomChanges.begin(), atomChanges.begin() + dropped);
+        atomChangeBase += dropped;
+    }
+};
+
+// Average water temperature in reactor (the grid keeps its sum up to date)
 float fluidEngine::AverageReactorTemperature()
 {
-    float avg = 0;
-    for (int i = 0; i < reactorWater.size(); i++) {
+    if (reactorWater.Size() == 0) {
+        return 0;
+    }
+    return reactorWater.Sum() / reactorWater.Size() + NR_WATER_TEMP_OFFSET;
+}
 
-        avg += (reactorWater[i].temperature + NR_WATER_TEMP_OFFSET);
+// Hottest water cell in reactor
+float fluidEngine::MaxReactorTemperature()
+{
+    if (reactorWater.Size() == 0) {
+        return 0;
     }
+    return reactorWater.Max() + NR_WATER_TEMP_OFFSET;
+}
 
-    return (avg / reactorWater.size());
+// Move every neutron, then resolve contacts, rod absorptions and escapes in neutron order
+void fluidEngine::TransportUpdate()
+{
+    int chunks = (neutrons.Size() + NE_TRANSPORT_CHUNK - 1) / NE_TRANSPORT_CHUNK;
+    if (transportBuffers.size() < chunks) {
+        transportBuffers.resize(chunks);
+    }
+    {
+        NE_PROFILE_SCOPE("CollisionUpdate");
+        // Default core gets a build with its size folded in
+        if (geometry.Is(NR_DEFAULT_SIZE_X, NR_DEFAULT_SIZE_Y)) {
+            workers.Run(chunks, [this](int chunk) { TransportChunk<NR_DEFAULT_SIZE_X, NR_DEFAULT_SIZE_Y>(chunk); });
+        } else {
+            workers.Run(chunks, [this](int chunk) { TransportChunk<0, 0>(chunk); });
+        }
+    }
+    {
+        NE_PROFILE_SCOPE("ReactionUpdate");
+        // Merge in neutron order, so the first neutron to reach an atom claims it
+        // (same result as a serial pass, whatever the thread count)
+        for (int c = 0; c < chunks; c++) {
+            for (int k = 0; k < transportBuffers[c].contacts.size(); k++) {
+                ReactionUpdate(transportBuffers[c].contacts[k].neutron, transportBuffers[c].contacts[k].atom);
+            }
+        }
+        for (int c = 0; c < chunks; c++) {
+            neutrons.Moderated(transportBuffers[c].moderated);
+            for (int k = 0; k < transportBuffers[c].kills.size(); k++) {
+                DestroyNeutron(transportBuffers[c].kills[k]);
+                if (events.IsOpen()) {
+                    RecordNeutronEvent(EVENT_ROD_ABSORPTION, transportBuffers[c].kills[k]);
+                }
+            }
+            for (int k = 0; k < transportBuffers[c].escapes.size(); k++) {
+                DestroyNeutron(transportBuffers[c].escapes[k]);
+                if (events.IsOpen()) {
+                    RecordNeutronEvent(EVENT_ESCAPE, transportBuffers[c].escapes[k]);
+                }
+            }
+        }
+    }
 }
 
 // Fluid engine tick
 void fluidEngine::Update()
 {
+    NE_PROFILE_SCOPE("Tick");
+    // Apply requests from other threads
+    {
+        std::lock_guard<std::mutex> guard(requestLock);
+        if (!requestedLoad.empty()) {
+            LoadCheckpoint(requestedLoad.c_str());
+            requestedLoad.clear();
+        }
+        if (!requestedSave.empty()) {
+            SaveCheckpoint(requestedSave.c_str());
+            requestedSave.clear();
+        }
+    }
+    if (requestedClear.exchange(false)) {
+        ClearNeutrons();
+    }
+    int summon = requestedNeutrons.exchange(0);
+    if (summon > 0) {
+        SummonNeutrons(summon, true);
+        neutrons.Commit();
+    }
+
+    ApplyRodBanks();
+    UpdateFluxMode();
+    UpdatePacketWeight();
+
     // Physics tick
-    for (int i = 0; i < neutrons.size(); i++) {
-        CollisionUpdate(&neutrons[i]);
-        ContainerUpdate(&neutrons[i]);
-        PositionUpdate(&neutrons[i]);
+    if (continuum) {
+        FluxUpdate();
+    } else {
+        TransportUpdate();
     }
-    for (int i = 0; i < reactorMaterial.size(); i++) {
-        DecayUpdate(&reactorMaterial[i]);
+    {
+        NE_PROFILE_SCOPE("DecayUpdate");
+        DecayUpdate();
     }
-    for (int i = 0; i < reactorWater.size(); i++) {
-        HeatTransferUpdate(&reactorWater[i]);
+    HeatTransferUpdate();
+    {
+        NE_PROFILE_SCOPE("Commit");
+        // Apply this tick's kills and births
+        neutrons.Commit();
+        tickCount++;
     }
-    neutronCount = neutrons.size();
+    if (settings.weightedNeutrons && !continuum) {
+        PopulationControl();
+    }
+    UpdateNeutronCount();
 
     // Update current statistics
     if (statUpdate <= 0) {
-
+        NE_PROFILE_SCOPE("Statistics");
         settings.stats.AddXenonData(GetXenonCount());
-        settings.stats.AddReactionData(neutrons.size());
+        settings.stats.AddReactionData(neutronCount);
         settings.stats.AddTempData(AverageReactorTemperature());
-        statUpdate = NE_TARGET_TICKRATE;
+        statUpdate = std::max(settings.statInterval, 1) - 1;
     } else {
         statUpdate--;
     }
+
+    if (telemetry.Wants(tickCount)) {
+        RecordTelemetry();
+    }
+}
+
+// Weight new packets are spawned at, so the packet count heads for settings.neutronPackets
+// Splitting stops at NE_PACKET_MAX_SPLIT packets per neutron
+void fluidEngine::UpdatePacketWeight()
+{
+    if (!settings.weightedNeutrons) {
+        packetWeight = 1;
+        return;
+    }
+    packetWeight = std::max(neutrons.Weight() / std::max(settings.neutronPackets, 1), 1.0 / NE_PACKET_MAX_SPLIT);
+}
+
+// Split packets much heavier than the packet weight, Russian roulette on packets much lighter
+// Children share their parent's weight and survivors take the packet weight, so the expected neutron count is unchanged
+void fluidEngine::PopulationControl()
+{
+    NE_PROFILE_SCOPE("PopulationControl");
+    neutrons.Resum();
+    UpdatePacketWeight();
+    int packets = neutrons.Size();
+    for (int i = 0; i < packets; i++) {
+        // Children hold at least one neutron (fractions of one neutron flying together would all meet the same atom,
+        // and only the first could react with it)
+        int split = std::min<long>(std::min(std::lround(neutrons.weight[i] / packetWeight), (long)neutrons.weight[i]), NE_PACKET_MAX_SPLIT);
+        if (neutrons.weight[i] > packetWeight * NE_PACKET_SPLIT && split > 1) {
+            // Children leave turned off the parent's direction by up to NE_PACKET_SPLIT_TURN (fresh random directions would
+            // restart their flight paths, and a restarted path outlives one that has been heading for a rod or wall)
+            double weight = neutrons.weight[i] / split;
+            neutrons.SetWeight(i, weight);
+            for (int k = 1; k < split; k++) {
+                double turn = (rngTransport.Uniform() * 2 - 1) * NE_PACKET_SPLIT_TURN;
+                double c = std::cos(turn);
+                double s = std::sin(turn);
+                neutrons.Spawn(neutrons.posX[i], neutrons.posY[i], neutrons.velX[i] * c - neutrons.velY[i] * s, neutrons.velX[i] * s + neutrons.velY[i] * c, neutrons.fast[i], weight);
+            }
+            continue;
+        }
+        if (neutrons.weight[i] >= packetWeight * NE_PACKET_ROULETTE) {
+            continue;
+        }
+        if (rngTransport.Uniform() * packetWeight < neutrons.weight[i]) {
+            neutrons.SetWeight(i, packetWeight);
+        } else {
+            DestroyNeutron(i);
+        }
+    }
+    neutrons.Commit();
+    neutrons.Resum();
+    UpdatePacketWeight();
+}
+
+// Physical neutrons, held by the pool or the flux field
+double fluidEngine::Population()
+{
+    return continuum ? flux.Sum() : neutrons.Weight();
+}
+
+// Refresh neutronCount from the pool or the flux field
+void fluidEngine::UpdateNeutronCount()
+{
+    neutronCount = WholeNeutrons(Population());
+}
+
+// Pick particles or the flux field for this tick
+// FLUX_AUTO switches up past continuumAbove and back under continuumBelow, so a population near one bound does not flip every tick
+void fluidEngine::UpdateFluxMode()
+{
+    bool wanted = continuum;
+    if (settings.fluxMode == FLUX_PARTICLES) {
+        wanted = false;
+    } else if (settings.fluxMode == FLUX_CONTINUUM) {
+        wanted = true;
+    } else if (!continuum && neutrons.Weight() > settings.continuumAbove) {
+        wanted = true;
+    } else if (continuum && flux.Sum() < settings.continuumBelow) {
+        wanted = false;
+    }
+    if (wanted && !continuum) {
+        ToContinuum();
+    } else if (!wanted && continuum) {
+        ToParticles();
+    }
+}
+
+// Fold every neutron (with its weight) into the nearest cell of its group
+void fluidEngine::ToContinuum()
+{
+    NE_PROFILE_SCOPE("ToContinuum");
+    neutrons.Commit(); // Births still pending from before the tick
+    flux.Clear();
+    // Heavy weighted packets can hold more than the field may (see NR_FLUX_CEILING)
+    double scale = std::min(NR_FLUX_CEILING / neutrons.Weight(), 1.0);
+    for (int i = 0; i < neutrons.Size(); i++) {
+        int cellX = std::min(std::max((int)std::floor(neutrons.posX[i] + 0.5), 0), geometry.sizeX - 1);
+        int cellY = std::min(std::max((int)std::floor(neutrons.posY[i] + 0.5), 0), geometry.sizeY - 1);
+        flux.Add(geometry.Index(cellX, cellY), neutrons.fast[i], neutrons.weight[i] * scale);
+    }
+    neutrons.Clear();
+    continuum = true;
+}
+
+// Sample neutrons back out of the flux field, at random points of each cell with random directions
+// Weighted transport samples packets at the weight it would pick for this population
+void fluidEngine::ToParticles()
+{
+    NE_PROFILE_SCOPE("ToParticles");
+    double weight = 1;
+    if (settings.weightedNeutrons) {
+        weight = std::max(flux.Sum() / std::max(settings.neutronPackets, 1), 1.0 / NE_PACKET_MAX_SPLIT);
+    }
+    for (int group = 0; group < 2; group++) {
+        bool fast = group == 0;
+        const float* field = fast ? flux.Fast() : flux.Thermal();
+        float speed = fast ? settings.fissionFastNeutronSpeed : settings.fissionNeutronSpeed;
+        for (int i = 0; i < flux.Size(); i++) {
+            double packets = field[i] / weight;
+            int count = packets;
+            count += rngTransport.Uniform() < packets - count;
+            for (int k = 0; k < count; k++) {
+                double x = i % geometry.sizeX + rngTransport.Range(-0.5, 0.5);
+                double y = i / geometry.sizeX + rngTransport.Range(-0.5, 0.5);
+                VM::Vector2 direction = rngTransport.UnitVector();
+                neutrons.Spawn(x, y, direction.x * speed, direction.y * speed, fast, weight);
+            }
+        }
+    }
+    flux.Clear();
+    neutrons.Commit();
+    continuum = false;
+}
+
+// Rod faces bordering each cell, from the rod columns
+// Column k's rod fills x + 0.5 in (k - 0.5, k + 0.5), so its faces run through the centres of cells k - 1 and k
+void fluidEngine::BuildRodEdges()
+{
+    rodAbsorberEdges.assign(geometry.Cells(), 0);
+    rodModeratorEdges.assign(geometry.Cells(), 0);
+    for (int k = rodColumns.First(); k <= rodColumns.Last(); k++) {
+        const rodColumn& rod = rodColumns.Column(k);
+        if (rodColumns.Empty(rod)) {
+            continue;
+        }
+        for (int x = k - 1; x <= k; x++) {
+            if (x < 0 || x >= geometry.sizeX) {
+                continue;
+            }
+            for (int y = 0; y < geometry.sizeY; y++) {
+                // Share of row y (y - 0.5 to y + 0.5) below the absorber tip and above the moderator tip
+                rodAbsorberEdges[geometry.Index(x, y)] += std::min(std::max(rod.absorberTip - y, 0.0f), 1.0f);
+                rodModeratorEdges[geometry.Index(x, y)] += std::min(std::max(y + 1 - rod.moderatorTip - RR_CR_PADDING, 0.0f), 1.0f);
+            }
+        }
+    }
+    rodEdgeVersion = rodTableVersion;
+}
+
+// Continuum transport: advance the flux field, then let thermal flux react with atoms
+// A neutron a step s from a rod face crosses it this tick with chance s / pi (uniform, isotropic flux),
+// and water below boiling in range absorbs with the same chance per neutron-cell pair as particles
+void fluidEngine::FluxUpdate()
+{
+    {
+        NE_PROFILE_SCOPE("FluxUpdate");
+        if (rodEdgeVersion != rodTableVersion || rodAbsorberEdges.size() != geometry.Cells()) {
+            BuildRodEdges();
+        }
+        const float fastStep = settings.fissionFastNeutronSpeed * NE_DELTATIME;
+        const float thermalStep = settings.fissionNeutronSpeed * NE_DELTATIME;
+        const float fastCross = fastStep / M_PI;
+        const float thermalCross = thermalStep / M_PI;
+        const float waterChance = settings.waterAbsorptionChance * NE_DELTATIME;
+        const float* temperature = reactorWater.Temperatures();
+        float* fastRemoval = flux.FastRemoval();
+        float* thermalRemoval = flux.ThermalRemoval();
+        float* moderation = flux.Moderation();
+        for (int y = 0; y < geometry.sizeY; y++) {
+            for (int x = 0; x < geometry.sizeX; x++) {
+                float water = 0;
+                for (int k = 0; k < waterStencil.size(); k++) {
+                    int cellX = x + waterStencil[k].x;
+                    int cellY = y + waterStencil[k].y;
+                    if (geometry.Contains(cellX, cellY) && temperature[geometry.Index(cellX, cellY)] < 100) {
+                        water += waterReach[k];
+                    }
+                }
+                int i = geometry.Index(x, y);
+                fastRemoval[i] = std::min(water * waterChance + rodAbsorberEdges[i] * fastCross, 1.0f);
+                thermalRemoval[i] = std::min(water * waterChance + rodAbsorberEdges[i] * thermalCross, 1.0f);
+                moderation[i] = std::min(rodModeratorEdges[i] * fastCross, 1 - fastRemoval[i]);
+            }
+        }
+        // Straight flights of NR_FLUX_FLIGHT cells on average spread like diffusion with D = v * flight / 2,
+        // and the core edge is crossed like a rod face
+        flux.Step(fastStep * NR_FLUX_FLIGHT / 2, thermalStep * NR_FLUX_FLIGHT / 2, fastCross, thermalCross, &workers);
+    }
+    {
+        NE_PROFILE_SCOPE("ReactionUpdate");
+        FluxReactionUpdate();
+    }
+    // A supercritical field grows without bound, hold it under the ceiling before a float cell overflows
+    if (flux.Sum() > NR_FLUX_CEILING) {
+        flux.Scale(NR_FLUX_CEILING / flux.Sum());
+    }
+}
+
+// Thermal flux meets U-235 and xenon atoms
+// Neutrons enter an atom's radius at flux * step per tick, as in ReactionUpdate each one that reaches U-235 fissions it,
+// so the fission source is proportional to thermal flux and U-235 with no limit of one reaction per atom
+// The atom itself is split (and a new one regenerated) with the chance at least one neutron reached it,
+// a xenon atom absorbs a single neutron with that chance
+void fluidEngine::FluxReactionUpdate()
+{
+    const float entering = settings.fissionNeutronSpeed * NE_DELTATIME;
+    const float* thermal = flux.Thermal();
+    double fissions = 0;
+    for (int i = 0; i < geometry.Cells(); i++) {
+        int j = materialGrid[i];
+        if (j == -1 || reactorMaterial[j].element == 0 || thermal[i] <= 0) {
+            continue;
+        }
+        int element = reactorMaterial[j].element;
+        VM::Vector2Int position = reactorMaterial[j].position;
+        float reached = thermal[i] * entering;
+        bool changed = rngTransport.Uniform() < -std::expm1(-reached);
+        if (element == 2) {
+            // Xe-135 -> Stabilised
+            if (!changed) {
+                continue;
+            }
+            flux.Add(i, false, -1);
+            SetElement(j, 0);
+            if (events.IsOpen()) {
+                events.Record(EVENT_XENON_ABSORPTION, tickCount + 1, position.x, position.y, false);
+            }
+            continue;
+        }
+        // U-235 -> Fission, every neutron that reached the atom
+        flux.Add(i, false, -reached);
+        flux.Add(i, true, reached * settings.fissionNeutronCount);
+        fissions += reached;
+        isPlayingSound = true;
+        if (changed) {
+            SetElement(j, 0);
+            if (events.IsOpen()) {
+                events.Record(EVENT_FISSION, tickCount + 1, position.x, position.y, false);
+            }
+            RegenInert();
+        }
+    }
+    fissionCount += fissions;
+}
+
+// Queue this tick's metrics for the telemetry writer
+void fluidEngine::RecordTelemetry()
+{
+    NE_PROFILE_SCOPE("RecordTelemetry");
+    telemetrySample sample;
+    sample.tick = tickCount;
+    sample.neutrons = neutronCount;
+    sample.fast = GetFastNeutronCount();
+    sample.thermal = GetThermalNeutronCount();
+    sample.xenon = GetXenonCount();
+    sample.averageTemperature = AverageReactorTemperature();
+    sample.maxTemperature = MaxReactorTemperature();
+    sample.banks = rodBanks.size();
+    std::copy(bankHeight, bankHeight + sample.banks, sample.bankHeight);
+    sample.fissions = WholeNeutrons(fissionCount);
+    fissionCount = 0;
+    telemetry.Push(sample);
+}
+
+// Launch simulation thread
+void fluidEngine::StartSimulation()
+{
+    if (simulationRunning) {
+        return;
+    }
+    simulationRunning = true;
+    simulationThread = std::thread(&fluidEngine::SimulationLoop, this);
+}
+
+// Stop and join simulation thread
+void fluidEngine::StopSimulation()
+{
+    simulationRunning = false;
+    if (simulationThread.joinable()) {
+        simulationThread.join();
+    }
+}
+
+// Fixed timestep loop, publishes a snapshot after every batch of ticks
+void fluidEngine::SimulationLoop()
+{
+    profiler::NameThread("Simulation");
+    typedef std::chrono::steady_clock clock;
+    const std::chrono::milliseconds frame(NE_TICKRATE_TIME);
+    clock::time_point previous = clock::now();
+    double accumulator = 0;
+
+    while (simulationRunning) {
+        clock::time_point now = clock::now();
+        double elapsed = std::chrono::duration<double>(now - previous).count();
+        previous = now;
+        float speed = settings.simulationSpeed;
+        int ticks = 0;
+
+        if (speed <= 0) {
+            // As fast as possible, publishing about once per frame
+            do {
+                Update();
+                ticks++;
+            } while (clock::now() - now < frame && simulationRunning);
+            accumulator = 0;
+        } else {
+            // Run every tick that is due, up to the catch up bound
+            accumulator += elapsed * speed;
+            while (accumulator >= NE_DELTATIME && ticks < NE_MAX_CATCHUP_TICKS) {
+                Update();
+                accumulator -= NE_DELTATIME;
+                ticks++;
+            }
+            if (accumulator >= NE_DELTATIME) {
+                printf("Simulation lagging: %d ticks dropped!\n", (int)(accumulator / NE_DELTATIME));
+                accumulator = 0;
+            }
+        }
+
+        if (ticks > 0) {
+            PublishSnapshot();
+        } else {
+            // Sleep until next tick is due
+            double wait = (NE_DELTATIME - accumulator) / speed;
+            std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+        }
+    }
+}
+
+// Encode current state into the next render snapshot and hand it to the renderer
+void fluidEngine::PublishSnapshot()
+{
+    NE_PROFILE_SCOPE("PublishSnapshot");
+    RenderSnapshot* frame = &snapshots.Back();
+    LinkReactorMaterialChanges(frame);
+    LinkReactorWaterChanges(frame);
+    LinkReactorRodChanges(frame);
+    LinkNeutronsToMain(&frame->neutrons);
+    frame->neutronCount = neutronCount;
+    frame->fastCount = GetFastNeutronCount();
+    frame->packetCount = GetPacketCount();
+    frame->continuum = continuum;
+    frame->xenonCount = GetXenonCount();
+    frame->averageTemperature = AverageReactorTemperature();
+    frame->maxTemperature = MaxReactorTemperature();
+    frame->rodBanks = rodBanks.size();
+    std::copy(bankHeight, bankHeight + NR_MAX_ROD_BANKS, frame->bankHeight);
+    frame->bankVersion = bankVersion;
+    frame->sizeX = geometry.sizeX;
+    frame->sizeY = geometry.sizeY;
+    snapshots.Publish();
 }
 
 // Encode reactor data to render data
 void fluidEngine::LinkReactorMaterialToMain(
     std::vector<CircleData>* updatedParticles)
 {
+    NE_PROFILE_SCOPE("LinkReactorMaterialToMain");
     for (int i = 0; i < reactorMaterial.size(); i++) {
         // Rounding
         VM::Vector2 temp((reactorMaterial[i].position.x * RR_SCALE) + RR_SCALE / 2, (reactorMaterial[i].position.y * RR_SCALE) + RR_SCALE / 2);
@@ -333,17 +1386,17 @@ void fluidEngine::LinkReactorMaterialToMain(
 void fluidEngine::LinkNeutronsToMain(
     std::vector<CircleData>* updatedParticles)
 {
-    // Clear neutrons
-    if (refreshNeutrons) {
-        updatedParticles->clear();
-        refreshNeutrons = false;
+    NE_PROFILE_SCOPE("LinkNeutronsToMain");
+    // Drop neutrons that no longer exist
+    if (updatedParticles->size() > neutrons.Size()) {
+        updatedParticles->erase(updatedParticles->begin() + neutrons.Size(), updatedParticles->end());
     }
 
-    for (int i = 0; i < neutrons.size(); i++) {
+    for (int i = 0; i < neutrons.Size(); i++) {
         // Rounding
-        VM::Vector2 temp((neutrons[i].position.x * RR_SCALE) + RR_SCALE / 2, (neutrons[i].position.y * RR_SCALE) + RR_SCALE / 2);
+        VM::Vector2 temp((neutrons.posX[i] * RR_SCALE) + RR_SCALE / 2, (neutrons.posY[i] * RR_SCALE) + RR_SCALE / 2);
         int colorId = 0;
-        if (neutrons[i].fast) {
+        if (neutrons.fast[i]) {
             colorId = 1;
         }
         CircleData circle(temp, (RR_SCALE / 5), colorId);
@@ -357,24 +1410,31 @@ void fluidEngine::LinkNeutronsToMain(
     }
 }
 
+// Water colour (0-255 from cold to hot, -1 above 100 degrees)
+static inline int WaterColour(float temperature)
+{
+    if (temperature < 0) {
+        // Blue
+        return 0;
+    } else if (temperature > 100) {
+        return -1;
+    }
+    return temperature * 2.55;
+};
+
 // Encode water data to render data
 void fluidEngine::LinkReactorWaterToMain(
     std::vector<RectangleData>* updatedParticles)
 {
-    for (int i = 0; i < reactorWater.size(); i++) {
+    NE_PROFILE_SCOPE("LinkReactorWaterToMain");
+    const float* temperature = reactorWater.Temperatures();
+    for (int i = 0; i < reactorWater.Size(); i++) {
+        int x = i % reactorWater.Width();
+        int y = i / reactorWater.Width();
         // Rounding
-        VM::Vector2 temp((reactorWater[i].position.x * RR_SCALE) + RR_SCALE / 2, (reactorWater[i].position.y * RR_SCALE) + RR_SCALE / 2);
+        VM::Vector2 temp((x * RR_SCALE) + RR_SCALE / 2, (y * RR_SCALE) + RR_SCALE / 2);
         VM::Vector2 size((RR_SCALE / 2) - RR_WATER_PADDING, (RR_SCALE / 2) - RR_WATER_PADDING);
-        int colour = -1;
-        if (reactorWater[i].temperature < 0) {
-            // Blue
-            colour = 0;
-        } else if (reactorWater[i].temperature > 100) {
-            colour = -1;
-        } else {
-            colour = reactorWater[i].temperature * 2.55;
-        }
-
+        int colour = WaterColour(temperature[i]);
         RectangleData rect(temp, size, colour);
 
         if (updatedParticles->size() <= i) {
@@ -391,25 +1451,27 @@ void fluidEngine::LinkReactorWaterToMain(
 void fluidEngine::LinkReactorRodToMain(
     std::vector<RectangleData>* updatedParticles)
 {
+    NE_PROFILE_SCOPE("LinkReactorRodToMain");
     for (int i = 0; i < controlRods.size(); i++) {
         // Control Rod
-        VM::Vector2 pos1((controlRods[i].xPosition * RR_SCALE), (((controlRods[i].height / 100) * RR_SCALE * NR_SIZE_Y) / 2));
-        VM::Vector2 size1((RR_SCALE / 3), ((controlRods[i].height / 100) * RR_SCALE * NR_SIZE_Y));
+        VM::Vector2 pos1((controlRods[i].xPosition * RR_SCALE), (((controlRods[i].height / 100) * RR_SCALE * geometry.sizeY) / 2));
+        VM::Vector2 size1((RR_SCALE / 3), ((controlRods[i].height / 100) * RR_SCALE * geometry.sizeY));
         // Moderator
-        VM::Vector2 pos2((controlRods[i].xPosition * RR_SCALE), ((((controlRods[i].height / 100) * NR_SIZE_Y + NR_SIZE_Y + RR_CR_PADDING) * RR_SCALE) / 2));
-        VM::Vector2 size2((RR_SCALE / 3), (((1 - controlRods[i].height / 100) * NR_SIZE_Y - RR_CR_PADDING) * RR_SCALE));
+        VM::Vector2 pos2((controlRods[i].xPosition * RR_SCALE), ((((controlRods[i].height / 100) * geometry.sizeY + geometry.sizeY + RR_CR_PADDING) * RR_SCALE) / 2));
+        VM::Vector2 size2((RR_SCALE / 3), (((1 - controlRods[i].height / 100) * geometry.sizeY - RR_CR_PADDING) * RR_SCALE));
         // Connecting Rod
-        VM::Vector2 pos3(((controlRods[i].xPosition) * RR_SCALE), (NR_SIZE_Y * RR_SCALE) / 2);
-        VM::Vector2 size3((RR_SCALE / 6), NR_SIZE_Y * RR_SCALE);
+        VM::Vector2 pos3(((controlRods[i].xPosition) * RR_SCALE), (geometry.sizeY * RR_SCALE) / 2);
+        VM::Vector2 size3((RR_SCALE / 6), geometry.sizeY * RR_SCALE);
 
         RectangleData rect1(pos1, size1, 0);
         RectangleData rect2(pos2, size2, 1);
         RectangleData rect3(pos3, size3, -1);
 
         if (updatedParticles->size() <= i * 3) {
-            updatedParticles->push_back(rect1);
-            updatedParticles->push_back(rect2);
+            // Same order as the update below (connecting rod drawn first)
             updatedParticles->push_back(rect3);
+            updatedParticles->push_back(rect2);
+            updatedParticles->push_back(rect1);
         } else {
             (*updatedParticles)[i * 3].position = pos3;
             (*updatedParticles)[i * 3].size = size3;
@@ -424,4 +1486,58 @@ void fluidEngine::LinkReactorRodToMain(
             (*updatedParticles)[i * 3 + 2].colourID = 0;
         }
     }
+}
+
+// Re-encode only atoms whose element changed since frame was last encoded
+void fluidEngine::LinkReactorMaterialChanges(RenderSnapshot* frame)
+{
+    NE_PROFILE_SCOPE("LinkReactorMaterialChanges");
+    uint64_t latest = atomChangeBase + atomChanges.size();
+    if (frame->layoutVersion != layoutVersion || frame->atomChange < atomChangeBase || frame->reactorMaterial.size() != reactorMaterial.size()) {
+        // New layout, or changes older than the journal
+        LinkReactorMaterialToMain(&frame->reactorMaterial);
+        if (frame->reactorMaterial.size() > reactorMaterial.size()) {
+            frame->reactorMaterial.erase(frame->reactorMaterial.begin() + reactorMaterial.size(), frame->reactorMaterial.end());
+        }
+    } else {
+        for (uint64_t c = frame->atomChange - atomChangeBase; c < atomChanges.size(); c++) {
+            int j = atomChanges[c];
+            frame->reactorMaterial[j].colourID = reactorMaterial[j].element;
+        }
+    }
+    frame->layoutVersion = layoutVersion;
+    frame->atomChange = latest;
+}
+
+// Recolour water (positions are only rebuilt when the core size changes)
+// Temperatures move everywhere every tick, so this stays one pass over the grid
+void fluidEngine::LinkReactorWaterChanges(RenderSnapshot* frame)
+{
+    NE_PROFILE_SCOPE("LinkReactorWaterChanges");
+    if (frame->sizeX != geometry.sizeX || frame->sizeY != geometry.sizeY || frame->reactorWater.size() != reactorWater.Size()) {
+        LinkReactorWaterToMain(&frame->reactorWater);
+        if (frame->reactorWater.size() > reactorWater.Size()) {
+            frame->reactorWater.erase(frame->reactorWater.begin() + reactorWater.Size(), frame->reactorWater.end());
+        }
+        return;
+    }
+    const float* temperature = reactorWater.Temperatures();
+    RectangleData* water = frame->reactorWater.data();
+    for (int i = 0; i < reactorWater.Size(); i++) {
+        water[i].colourID = WaterColour(temperature[i]);
+    }
+}
+
+// Rebuild rods only after one moved
+void fluidEngine::LinkReactorRodChanges(RenderSnapshot* frame)
+{
+    NE_PROFILE_SCOPE("LinkReactorRodChanges");
+    if (frame->rodVersion == rodVersion && frame->reactorRod.size() == controlRods.size() * 3) {
+        return;
+    }
+    LinkReactorRodToMain(&frame->reactorRod);
+    if (frame->reactorRod.size() > controlRods.size() * 3) {
+        frame->reactorRod.erase(frame->reactorRod.begin() + controlRods.size() * 3, frame->reactorRod.end());
+    }
+    frame->rodVersion = rodVersion;
 }
\ No newline at end of file
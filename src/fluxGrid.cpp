@@ -0,0 +1,263 @@
+#include "../include/fluxGrid.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FLUX_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define FLUX_AVX2_TARGET
+#else
+#define FLUX_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+// Cells per worker chunk
+#define FLUX_CHUNK_CELLS 16384
+// Explicit five point exchange is only stable while a cell keeps some of its own flux
+#define FLUX_MAX_DIFFUSION 0.24f
+
+// Stencil parameters shared by kernels
+struct fluxStep {
+    const float* fastIn;
+    const float* thermalIn;
+    float* fastOut;
+    float* thermalOut;
+    const float* fastRemoval;
+    const float* thermalRemoval;
+    const float* moderation;
+    int width;
+    int height;
+    float fastDiffusion;
+    float thermalDiffusion;
+    // Outside the core a cell sees itself scaled by these, so each outer face only leaks the leak share
+    float fastEdge;
+    float thermalEdge;
+};
+
+// Diffuse, absorb and moderate one cell, returns the new fast and thermal flux through f and t
+static inline void StepCell(const fluxStep* s, int i, int x, int y, float* f, float* t)
+{
+    float fastEdge = s->fastIn[i] * s->fastEdge;
+    float thermalEdge = s->thermalIn[i] * s->thermalEdge;
+    float fastNear = x > 0 ? s->fastIn[i - 1] : fastEdge;
+    float thermalNear = x > 0 ? s->thermalIn[i - 1] : thermalEdge;
+    fastNear += x < s->width - 1 ? s->fastIn[i + 1] : fastEdge;
+    thermalNear += x < s->width - 1 ? s->thermalIn[i + 1] : thermalEdge;
+    fastNear += y > 0 ? s->fastIn[i - s->width] : fastEdge;
+    thermalNear += y > 0 ? s->thermalIn[i - s->width] : thermalEdge;
+    fastNear += y < s->height - 1 ? s->fastIn[i + s->width] : fastEdge;
+    thermalNear += y < s->height - 1 ? s->thermalIn[i + s->width] : thermalEdge;
+    float fast = s->fastIn[i] * (1 - 4 * s->fastDiffusion) + s->fastDiffusion * fastNear;
+    float thermal = s->thermalIn[i] * (1 - 4 * s->thermalDiffusion) + s->thermalDiffusion * thermalNear;
+    float moderated = fast * s->moderation[i];
+    *f = fast * (1 - s->fastRemoval[i]) - moderated;
+    *t = thermal * (1 - s->thermalRemoval[i]) + moderated;
+}
+
+// Portable kernel for rows [y0, y1), also sums the written cells of each group
+static void StepRowsScalar(const fluxStep* s, int y0, int y1, double* fastSum, double* thermalSum)
+{
+    double fastTotal = 0;
+    double thermalTotal = 0;
+    for (int y = y0; y < y1; y++) {
+        for (int x = 0; x < s->width; x++) {
+            int i = x + y * s->width;
+            StepCell(s, i, x, y, &s->fastOut[i], &s->thermalOut[i]);
+            fastTotal += s->fastOut[i];
+            thermalTotal += s->thermalOut[i];
+        }
+    }
+    *fastSum = fastTotal;
+    *thermalSum = thermalTotal;
+}
+
+#ifdef FLUX_X86
+// Widen eight floats into a double accumulator
+FLUX_AVX2_TARGET static inline __m256d Accumulate8(__m256d total, __m256 v)
+{
+    total = _mm256_add_pd(total, _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+    return _mm256_add_pd(total, _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+}
+
+// AVX2 kernel for rows [y0, y1)
+// The first and last cell of a row (one neighbour outside the core) and the row tail are scalar
+FLUX_AVX2_TARGET static void StepRowsAVX2(const fluxStep* s, int y0, int y1, double* fastSum, double* thermalSum)
+{
+    __m256d fastTotal8 = _mm256_setzero_pd();
+    __m256d thermalTotal8 = _mm256_setzero_pd();
+    double fastTotal = 0;
+    double thermalTotal = 0;
+    const __m256 fastKeep = _mm256_set1_ps(1 - 4 * s->fastDiffusion);
+    const __m256 thermalKeep = _mm256_set1_ps(1 - 4 * s->thermalDiffusion);
+    const __m256 fastShare = _mm256_set1_ps(s->fastDiffusion);
+    const __m256 thermalShare = _mm256_set1_ps(s->thermalDiffusion);
+    const __m256 one = _mm256_set1_ps(1);
+    const __m256 fastEdge = _mm256_set1_ps(s->fastEdge);
+    const __m256 thermalEdge = _mm256_set1_ps(s->thermalEdge);
+    for (int y = y0; y < y1; y++) {
+        bool below = y > 0;
+        bool above = y < s->height - 1;
+        int x = 0;
+        auto scalarCell = [&](int cx) {
+            int i = cx + y * s->width;
+            StepCell(s, i, cx, y, &s->fastOut[i], &s->thermalOut[i]);
+            fastTotal += s->fastOut[i];
+            thermalTotal += s->thermalOut[i];
+        };
+        if (s->width > 0) {
+            scalarCell(x++);
+        }
+        for (; x + 8 <= s->width - 1; x += 8) {
+            int i = x + y * s->width;
+            __m256 fastSelf = _mm256_loadu_ps(s->fastIn + i);
+            __m256 thermalSelf = _mm256_loadu_ps(s->thermalIn + i);
+            __m256 fastNear = _mm256_add_ps(_mm256_loadu_ps(s->fastIn + i - 1), _mm256_loadu_ps(s->fastIn + i + 1));
+            __m256 thermalNear = _mm256_add_ps(_mm256_loadu_ps(s->thermalIn + i - 1), _mm256_loadu_ps(s->thermalIn + i + 1));
+            fastNear = _mm256_add_ps(fastNear, below ? _mm256_loadu_ps(s->fastIn + i - s->width) : _mm256_mul_ps(fastSelf, fastEdge));
+            thermalNear = _mm256_add_ps(thermalNear, below ? _mm256_loadu_ps(s->thermalIn + i - s->width) : _mm256_mul_ps(thermalSelf, thermalEdge));
+            fastNear = _mm256_add_ps(fastNear, above ? _mm256_loadu_ps(s->fastIn + i + s->width) : _mm256_mul_ps(fastSelf, fastEdge));
+            thermalNear = _mm256_add_ps(thermalNear, above ? _mm256_loadu_ps(s->thermalIn + i + s->width) : _mm256_mul_ps(thermalSelf, thermalEdge));
+            __m256 fast = _mm256_add_ps(_mm256_mul_ps(fastSelf, fastKeep), _mm256_mul_ps(fastNear, fastShare));
+            __m256 thermal = _mm256_add_ps(_mm256_mul_ps(thermalSelf, thermalKeep), _mm256_mul_ps(thermalNear, thermalShare));
+            __m256 moderated = _mm256_mul_ps(fast, _mm256_loadu_ps(s->moderation + i));
+            fast = _mm256_sub_ps(_mm256_mul_ps(fast, _mm256_sub_ps(one, _mm256_loadu_ps(s->fastRemoval + i))), moderated);
+            thermal = _mm256_add_ps(_mm256_mul_ps(thermal, _mm256_sub_ps(one, _mm256_loadu_ps(s->thermalRemoval + i))), moderated);
+            _mm256_storeu_ps(s->fastOut + i, fast);
+            _mm256_storeu_ps(s->thermalOut + i, thermal);
+            fastTotal8 = Accumulate8(fastTotal8, fast);
+            thermalTotal8 = Accumulate8(thermalTotal8, thermal);
+        }
+        for (; x < s->width; x++) {
+            scalarCell(x);
+        }
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, fastTotal8);
+    *fastSum = fastTotal + lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_storeu_pd(lanes, thermalTotal8);
+    *thermalSum = thermalTotal + lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+#endif
+
+// Allocate grid
+void fluxGrid::Resize(int w, int h)
+{
+    width = w;
+    height = h;
+    fast.assign(w * h, 0);
+    thermal.assign(w * h, 0);
+    nextFast.assign(w * h, 0);
+    nextThermal.assign(w * h, 0);
+    fastRemoval.assign(w * h, 0);
+    thermalRemoval.assign(w * h, 0);
+    moderation.assign(w * h, 0);
+    fastSum = 0;
+    thermalSum = 0;
+}
+
+// Add neutrons to one cell
+void fluxGrid::Add(int i, bool fastGroup, float n)
+{
+    float& cell = fastGroup ? fast[i] : thermal[i];
+    double& total = fastGroup ? fastSum : thermalSum;
+    n = std::max(n, -cell);
+    cell += n;
+    total += n;
+}
+
+// Remove all flux
+void fluxGrid::Clear()
+{
+    std::fill(fast.begin(), fast.end(), 0.0f);
+    std::fill(thermal.begin(), thermal.end(), 0.0f);
+    fastSum = 0;
+    thermalSum = 0;
+}
+
+// Scale both groups
+void fluxGrid::Scale(double factor)
+{
+    for (int i = 0; i < Size(); i++) {
+        fast[i] *= factor;
+        thermal[i] *= factor;
+    }
+    Refresh();
+}
+
+// Recompute aggregates from current
+void fluxGrid::Refresh()
+{
+    fastSum = 0;
+    thermalSum = 0;
+    for (int i = 0; i < Size(); i++) {
+        fastSum += fast[i];
+        thermalSum += thermal[i];
+    }
+}
+
+// Kernel used by Step
+waterKernel fluxGrid::ActiveKernel() const
+{
+    static const bool avx2 = waterGrid::HasAVX2();
+    if (kernel == WATER_KERNEL_SCALAR || !avx2) {
+        return WATER_KERNEL_SCALAR;
+    }
+    return WATER_KERNEL_AVX2;
+}
+
+// Advance one step
+void fluxGrid::Step(float fastDiffusion, float thermalDiffusion, float fastLeak, float thermalLeak, workerPool* workers)
+{
+    if (Size() == 0) {
+        return;
+    }
+    fluxStep s;
+    s.fastIn = fast.data();
+    s.thermalIn = thermal.data();
+    s.fastOut = nextFast.data();
+    s.thermalOut = nextThermal.data();
+    s.fastRemoval = fastRemoval.data();
+    s.thermalRemoval = thermalRemoval.data();
+    s.moderation = moderation.data();
+    s.width = width;
+    s.height = height;
+    s.fastDiffusion = std::min(std::max(fastDiffusion, 0.0f), FLUX_MAX_DIFFUSION);
+    s.thermalDiffusion = std::min(std::max(thermalDiffusion, 0.0f), FLUX_MAX_DIFFUSION);
+    // Exchange with a mirror cell at edge * flux loses diffusion * (1 - edge), which is the leak when edge = 1 - leak / diffusion
+    s.fastEdge = s.fastDiffusion > 0 ? std::min(std::max(1 - fastLeak / s.fastDiffusion, 0.0f), 1.0f) : 1;
+    s.thermalEdge = s.thermalDiffusion > 0 ? std::min(std::max(1 - thermalLeak / s.thermalDiffusion, 0.0f), 1.0f) : 1;
+
+    void (*stepRows)(const fluxStep*, int, int, double*, double*) = StepRowsScalar;
+#ifdef FLUX_X86
+    if (ActiveKernel() == WATER_KERNEL_AVX2) {
+        stepRows = StepRowsAVX2;
+    }
+#endif
+
+    // Split by rows
+    int rowsPerChunk = std::max(1, FLUX_CHUNK_CELLS / width);
+    int chunks = (height + rowsPerChunk - 1) / rowsPerChunk;
+    chunkFast.resize(chunks);
+    chunkThermal.resize(chunks);
+    auto stepChunk = [&](int chunk) {
+        stepRows(&s, chunk * rowsPerChunk, std::min(height, (chunk + 1) * rowsPerChunk), &chunkFast[chunk], &chunkThermal[chunk]);
+    };
+    if (workers == nullptr) {
+        for (int c = 0; c < chunks; c++) {
+            stepChunk(c);
+        }
+    } else {
+        workers->Run(chunks, stepChunk);
+    }
+    fast.swap(nextFast);
+    thermal.swap(nextThermal);
+
+    // Combine partials in chunk order, so the sums do not depend on the thread count
+    fastSum = 0;
+    thermalSum = 0;
+    for (int c = 0; c < chunks; c++) {
+        fastSum += chunkFast[c];
+        thermalSum += chunkThermal[c];
+    }
+}
@@ -3,10 +3,10 @@
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
-#include <thread>
 
 #include "../include/core.h"
 #include "../include/fluidEngine.h"
+#include "../include/profiler.h"
 #include "../include/renderEngine.h"
 #include "../include/soundMixer.h"
 
@@ -17,14 +17,11 @@ soundMixer* sound = nullptr;
 Uint32 frameStart;
 int currentTickTime;
 
-std::vector<CircleData> reactorMaterial;
-std::vector<CircleData> neutrons;
-std::vector<RectangleData> reactorWater;
-std::vector<RectangleData> reactorRod;
 // Entrypoint
 int main(int argc, char* args[])
 {
     // Engines
+    profiler::NameThread("Main");
     render = new renderEngine();
     fluid = new fluidEngine();
     sound = new soundMixer();
@@ -35,90 +32,68 @@ int main(int argc, char* args[])
     render->Initialise("Nuclear Reactor Simulator", 1280 * 1.3, 720 * 1.3); // Old size 1280 * 720
     render->LinkSettings(&fluid->settings);
     render->Start();
-    fluid->Start(render);
+    fluid->Start();
     fluid->settings.stats.ZeroGraph();
-    render->neutronCount = &fluid->neutronCount;
 
-    // Spawn initial reactor
-    for (int x = 0; x < NR_SIZE_X; x++) {
-        for (int y = 0; y < NR_SIZE_Y; y++) {
-            fluid->AddWater(x, y);
-            if (RandomRange(0, 1.0) < NR_ENRICHMENT) {
-                fluid->AddReactorMaterial(x, y, 1);
-            } else {
-                fluid->AddReactorMaterial(x, y, 0);
-            }
-        }
+    // Resume from checkpoint if given, otherwise spawn initial reactor
+    if (argc < 2 || !fluid->LoadCheckpoint(args[1])) {
+        fluid->GenerateReactor(NR_ENRICHMENT);
     }
 
-    // Spawn rods
-    fluid->AddControlRod(0, 0, true); // Static
-    fluid->AddControlRod(4, 100, false);
-    fluid->AddControlRod(8, 0, true); // Static
-    fluid->AddControlRod(12, 100, false);
-    fluid->AddControlRod(16, 0, true); // Static
-    fluid->AddControlRod(20, 100, false);
-    fluid->AddControlRod(24, 0, true); // Static
-    fluid->AddControlRod(28, 100, false);
-    fluid->AddControlRod(32, 0, true); // Static
-    fluid->AddControlRod(36, 100, false);
-    fluid->AddControlRod(40, 0, true); // Static
-
     // Create links to renderer
-    render->LinkReactorMaterials(&reactorMaterial);
-    render->LinkNeutrons(&neutrons);
-    render->LinkReactorWater(&reactorWater);
-    render->LinkReactorRod(&reactorRod);
+    fluid->PublishSnapshot();
+    render->LinkSnapshots(&fluid->snapshots);
+
+    // Simulation runs on its own thread from here
+    fluid->StartSimulation();
 
     // Tick loop
     while (render->Running()) {
         // Start tick time
         frameStart = SDL_GetTicks();
 
-        // Update & render
-        std::thread fluidThread(&fluidEngine::Update, fluid);
-        // Sync with reactor engine
-        fluid->LinkReactorMaterialToMain(&reactorMaterial);
-        fluid->LinkNeutronsToMain(&neutrons);
-        fluid->LinkReactorWaterToMain(&reactorWater);
-        fluid->LinkReactorRodToMain(&reactorRod);
         // Sync user feedback
         if (render->AddNetron() > 0) {
-            for (int i = 0; i < render->AddNetron(); i++) {
-                fluid->AddNeutron(RandomRange(0, NR_SIZE_X), RandomRange(0, NR_SIZE_Y), true);
-            }
+            fluid->RequestNeutrons(render->AddNetron());
         }
         if (render->ClearNeutrons()) {
-            fluid->ClearNeutrons();
+            fluid->RequestClearNeutrons();
         }
-        if (fluid->isPlayingSound) {
+        if (render->SaveState()) {
+            fluid->RequestSave(NR_CHECKPOINT_PATH);
+        }
+        if (render->LoadState()) {
+            fluid->RequestLoad(NR_CHECKPOINT_PATH);
+        }
+        if (render->RecordTelemetry() != fluid->telemetry.IsOpen()) {
+            if (render->RecordTelemetry()) {
+                render->SetRecordTelemetry(fluid->telemetry.Open(NR_TELEMETRY_PATH, TELEMETRY_CSV, 1, 0));
+            } else {
+                fluid->telemetry.Close();
+            }
+        }
+        if (fluid->isPlayingSound.exchange(false)) {
             sound->PlaySound(geigerSnd);
-            fluid->isPlayingSound = false;
         }
 
-        // Adjust control rods
-        fluid->SetControlRodHeight(1, fluid->settings.rodHeight_1);
-        fluid->SetControlRodHeight(3, fluid->settings.rodHeight_2);
-        fluid->SetControlRodHeight(5, fluid->settings.rodHeight_3);
-        fluid->SetControlRodHeight(7, fluid->settings.rodHeight_4);
-        fluid->SetControlRodHeight(9, fluid->settings.rodHeight_5);
+        // Control rods, applied by the simulation thread
+        fluid->RequestBankHeights(render->BankHeights(), render->BankCount(), render->BankVersion());
 
         render->Update();
         render->Render();
 
-        fluidThread.join();
-
         // Check for delays
         currentTickTime = SDL_GetTicks() - frameStart;
         if (NE_TICKRATE_TIME > currentTickTime) {
             SDL_Delay(NE_TICKRATE_TIME - currentTickTime);
         } else {
-            std::cout << "Tickrate lagging: ";
+            std::cout << "Framerate lagging: ";
             std::cout << (currentTickTime - NE_TICKRATE_TIME);
             std::cout << "ms behind!" << std::endl;
         }
     }
     // Clean
+    fluid->StopSimulation();
     sound->QuitMixer();
     render->Clean();
     return 0;
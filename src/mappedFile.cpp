@@ -0,0 +1,96 @@
+#include "../include/mappedFile.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+bool mappedFile::Open(const char* path)
+{
+    Close();
+    HANDLE f = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (f == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER length;
+    if (!GetFileSizeEx(f, &length) || length.QuadPart == 0) {
+        CloseHandle(f);
+        return false;
+    }
+    HANDLE m = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m == NULL) {
+        CloseHandle(f);
+        return false;
+    }
+    const void* view = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL) {
+        CloseHandle(m);
+        CloseHandle(f);
+        return false;
+    }
+    file = f;
+    mapping = m;
+    data = (const uint8_t*)view;
+    size = length.QuadPart;
+    return true;
+};
+
+void mappedFile::Close()
+{
+    if (data != nullptr) {
+        UnmapViewOfFile(data);
+        CloseHandle(mapping);
+        CloseHandle(file);
+    }
+    data = nullptr;
+    size = 0;
+    file = nullptr;
+    mapping = nullptr;
+};
+
+#else
+
+bool mappedFile::Open(const char* path)
+{
+    Close();
+    int f = open(path, O_RDONLY);
+    if (f < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(f, &info) != 0 || info.st_size == 0) {
+        close(f);
+        return false;
+    }
+    int flags = MAP_PRIVATE;
+#if defined(MAP_POPULATE)
+    // Whole file is read right away, fault it in up front
+    flags |= MAP_POPULATE;
+#endif
+    void* view = mmap(nullptr, info.st_size, PROT_READ, flags, f, 0);
+    // Mapping holds its own reference to the file
+    close(f);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    data = (const uint8_t*)view;
+    size = info.st_size;
+    return true;
+};
+
+void mappedFile::Close()
+{
+    if (data != nullptr) {
+        munmap((void*)data, size);
+    }
+    data = nullptr;
+    size = 0;
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "../include/profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+std::atomic<bool> profiler::enabled { false };
+
+// Every ring handed out so far, and those whose thread has exited
+// A new thread reuses a free ring, so thread churn (one pool per engine) does not grow memory
+static std::mutex ringLock;
+static std::vector<std::unique_ptr<profileRing>> rings;
+static std::vector<profileRing*> freeRings;
+static thread_local const char* localName = nullptr;
+
+// Calling thread's ring, returned to the free list when the thread exits
+struct ringLease {
+    profileRing* ring = nullptr;
+    ~ringLease()
+    {
+        if (ring != nullptr) {
+            std::lock_guard<std::mutex> guard(ringLock);
+            freeRings.push_back(ring);
+        }
+    };
+};
+static thread_local ringLease localRing;
+static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+profileRing::profileRing(int i, const char* threadName)
+    : slots(NE_PROFILE_CAPACITY)
+{
+    index = i;
+    name = threadName;
+};
+
+// Hand ring to a new thread
+void profileRing::Reset(const char* threadName)
+{
+    name = threadName;
+    head.store(0, std::memory_order_release);
+};
+
+// Copy events out, oldest first
+// Events are pushed as scopes close, so end times only grow and the walk can stop at since
+void profileRing::Collect(std::vector<profileEvent>* out, int64_t since) const
+{
+    uint64_t h = head.load(std::memory_order_acquire);
+    uint64_t first = h > NE_PROFILE_CAPACITY ? h - NE_PROFILE_CAPACITY : 0;
+    int begin = out->size();
+    uint64_t i = h;
+    while (i > first) {
+        const slot* s = &slots[(i - 1) % NE_PROFILE_CAPACITY];
+        profileEvent e;
+        e.zone = s->zone.load(std::memory_order_relaxed);
+        e.start = s->start.load(std::memory_order_relaxed);
+        e.end = s->end.load(std::memory_order_relaxed);
+        e.thread = index;
+        if (e.end <= since) {
+            break;
+        }
+        out->push_back(e);
+        i--;
+    }
+    // Drop slots the writer may have reused while we copied (they are the oldest ones)
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t now = head.load(std::memory_order_relaxed);
+    uint64_t safe = now > NE_PROFILE_CAPACITY ? now - NE_PROFILE_CAPACITY : 0;
+    if (i < safe) {
+        out->resize(out->size() - (std::min(safe, h) - i));
+    }
+    std::reverse(out->begin() + begin, out->end());
+};
+
+int64_t profiler::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+};
+
+void profiler::NameThread(const char* name)
+{
+    localName = name;
+};
+
+void profiler::Record(const char* zone, int64_t start, int64_t end)
+{
+    if (localRing.ring == nullptr) {
+        std::lock_guard<std::mutex> guard(ringLock);
+        const char* name = localName != nullptr ? localName : "Thread";
+        if (!freeRings.empty()) {
+            // Readers also hold ringLock, so the reset cannot race a Collect
+            localRing.ring = freeRings.back();
+            freeRings.pop_back();
+            localRing.ring->Reset(name);
+        } else {
+            rings.emplace_back(new profileRing(rings.size(), name));
+            localRing.ring = rings.back().get();
+        }
+    }
+    localRing.ring->Push(zone, start, end);
+};
+
+void profiler::Collect(std::vector<profileEvent>* out, int64_t since)
+{
+    std::lock_guard<std::mutex> guard(ringLock);
+    for (int i = 0; i < rings.size(); i++) {
+        rings[i]->Collect(out, since);
+    }
+};
+
+// Complete ("X") events, one track per thread
+bool profiler::WriteChromeTrace(const char* path, double seconds)
+{
+    std::vector<profileEvent> events;
+    Collect(&events, Now() - (int64_t)(seconds * 1e9));
+
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    {
+        std::lock_guard<std::mutex> guard(ringLock);
+        for (int i = 0; i < rings.size(); i++) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+                first ? "" : ",\n", rings[i]->Index(), rings[i]->Name(), rings[i]->Index());
+            first = false;
+        }
+    }
+    for (int i = 0; i < events.size(); i++) {
+        fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+            first ? "" : ",\n", events[i].zone, events[i].thread, events[i].start / 1e3, (events[i].end - events[i].start) / 1e3);
+        first = false;
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+};
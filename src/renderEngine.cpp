@@ -12,8 +12,10 @@
 #include <SDL_opengl.h>
 #include <SDL_video.h>
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 
 #include "../depend/imgui/backends/imgui_impl_opengl3.h"
@@ -22,6 +24,8 @@
 #include "../depend/implot/implot.h"
 #include "../include/PIDController.h"
 #include "../include/core.h"
+#include "../include/coreRaster.h"
+#include "../include/profiler.h"
 
 renderEngine::renderEngine() { }
 renderEngine::~renderEngine() { }
@@ -30,13 +34,8 @@ SDL_GLContext gl_context;
 ImGuiIO io;
 ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
-// Draw references
-std::vector<CircleData>* reactorMaterialRef;
-std::vector<CircleData>* neturonRef;
-std::vector<RectangleData>* waterRef;
-std::vector<RectangleData>* rodRef;
-
 // Simple control rod settings
+int simulationSpeedMode = 0; // 0 = 1x, 1 = 10x, 2 = Max
 bool global = true;
 bool automode = false;
 int automode_goal = 30;
@@ -50,22 +49,33 @@ float controller_Kp = 0.5;
 float controller_Ki = 0.1;
 float controller_Kd = 1;
 
-// Linking render data
-void renderEngine::LinkReactorMaterials(std::vector<CircleData>* newPos)
-{
-    reactorMaterialRef = newPos;
-}
-void renderEngine::LinkNeutrons(std::vector<CircleData>* newPos)
-{
-    neturonRef = newPos;
-}
-void renderEngine::LinkReactorWater(std::vector<RectangleData>* newPos)
+// Core view
+int coreViewMode = 0; // 0 = auto, 1 = primitives, 2 = texture
+coreRaster coreImage;
+GLuint coreTexture = 0;
+int coreTextureWidth = 0;
+int coreTextureHeight = 0;
+
+// Profiler panel
+bool profilerEnabled = false;
+float profilerTraceSeconds = 5;
+int64_t profilerLastCollect = 0;
+std::vector<profileEvent> profilerEvents;
+std::string profilerStatus;
+// Stacked phases (wall time of each, summed over a frame)
+const char* profilerPhases[] = { "CollisionUpdate", "ReactionUpdate", "DecayUpdate", "HeatTransferUpdate", "Commit", "Statistics", "PublishSnapshot", "renderEngine::Update", "renderEngine::Render" };
+const int profilerPhaseCount = sizeof(profilerPhases) / sizeof(profilerPhases[0]);
+float profilerHistory[profilerPhaseCount][RR_PROFILE_HISTORY] = {};
+float frameTimes[RR_PROFILE_HISTORY] = {};
+int profilerHead = 0;
+int frameCount = 0;
+
+// ImPlot getter over a statistics view
+template <typename T>
+ImPlotPoint StatGetter(int idx, void* data)
 {
-    waterRef = newPos;
-}
-void renderEngine::LinkReactorRod(std::vector<RectangleData>* newPos)
-{
-    rodRef = newPos;
+    statView<T>* view = (statView<T>*)data;
+    return ImPlotPoint(idx, (double)view->At(idx));
 }
 
 // Start engine
@@ -113,9 +123,19 @@ void renderEngine::Start()
 // Tick renderengine
 void renderEngine::Update()
 {
+    NE_PROFILE_SCOPE("renderEngine::Update");
     // Tick
     tick++;
 
+    // Latest complete frame from the simulation
+    bool freshFrame = snapshots->Acquire();
+    const RenderSnapshot& frame = snapshots->Front();
+    const std::vector<CircleData>* reactorMaterialRef = &frame.reactorMaterial;
+    const std::vector<CircleData>* neturonRef = &frame.neutrons;
+    const std::vector<RectangleData>* waterRef = &frame.reactorWater;
+    const std::vector<RectangleData>* rodRef = &frame.reactorRod;
+    VM::Vector2 coreSize(frame.sizeX * RR_SCALE, frame.sizeY * RR_SCALE);
+
     // Handle events
     SDL_Event event;
     while (SDL_PollEvent(&event)) {
@@ -150,6 +170,44 @@ void renderEngine::Update()
     ImGui::SliderFloat("Dissipate Speed", &settings->heatDissipate, 0, 100);
     ImGui::SliderFloat("Heat Transfer Speed", &settings->heatTransfer, 0, 100);
     ImGui::SliderFloat("Water Flow Rate", &settings->waterFlow, 0, 100);
+    ImGui::Text("Neutron Paths");
+    ImGui::SameLine();
+    ImGui::RadioButton("Fixed Step", &settings->transportMode, TRANSPORT_FIXED_STEP);
+    ImGui::SameLine();
+    ImGui::RadioButton("Exact (DDA)", &settings->transportMode, TRANSPORT_TRAVERSAL);
+    ImGui::Text("Neutron Model");
+    ImGui::SameLine();
+    ImGui::RadioButton("Auto", &settings->fluxMode, FLUX_AUTO);
+    ImGui::SameLine();
+    ImGui::RadioButton("Particles", &settings->fluxMode, FLUX_PARTICLES);
+    ImGui::SameLine();
+    ImGui::RadioButton("Continuum", &settings->fluxMode, FLUX_CONTINUUM);
+    ImGui::Checkbox("Weighted Neutrons", &settings->weightedNeutrons);
+    if (settings->weightedNeutrons) {
+        ImGui::SliderInt("Packet Target", &settings->neutronPackets, 1000, 200000);
+    }
+    ImGui::Separator();
+    ImGui::Text("Simulation Speed");
+    ImGui::SameLine();
+    ImGui::RadioButton("1x", &simulationSpeedMode, 0);
+    ImGui::SameLine();
+    ImGui::RadioButton("10x", &simulationSpeedMode, 1);
+    ImGui::SameLine();
+    ImGui::RadioButton("Max", &simulationSpeedMode, 2);
+    if (simulationSpeedMode == 0) {
+        settings->simulationSpeed = 1;
+    } else if (simulationSpeedMode == 1) {
+        settings->simulationSpeed = 10;
+    } else {
+        settings->simulationSpeed = 0;
+    }
+    ImGui::Separator();
+    saveState = ImGui::Button("Save State");
+    ImGui::SameLine();
+    loadState = ImGui::Button("Load State");
+    ImGui::SameLine();
+    ImGui::Text(NR_CHECKPOINT_PATH);
+    ImGui::Checkbox("Record Telemetry (" NR_TELEMETRY_PATH "_*.csv)", &recordTelemetry);
     ImGui::End();
 
     // Control rod Manager
@@ -159,16 +217,23 @@ void renderEngine::Update()
     ImGui::Checkbox("Automatic", &automode);
     ImGui::Checkbox("Global", &global);
     ImGui::Checkbox("Use PID", &useController);
-    ImGui::BeginDisabled(!global || automode);
-    ImGui::SliderFloat("Rod Insertion", &settings->rodHeight_1, 1, 100);
+    // Bank 1 is the master for global and automatic control
+    int banks = std::min(frame.rodBanks, NR_MAX_ROD_BANKS);
+    if (frame.bankVersion != bankVersion) {
+        std::copy(frame.bankHeight, frame.bankHeight + NR_MAX_ROD_BANKS, bankHeight);
+        bankVersion = frame.bankVersion;
+    }
+    bankCount = banks;
+    ImGui::BeginDisabled(!global || automode || banks == 0);
+    ImGui::SliderFloat("Rod Insertion", &bankHeight[0], 1, 100);
     ImGui::EndDisabled();
     ImGui::Separator();
     ImGui::BeginDisabled(global || automode);
-    ImGui::SliderFloat("Rod 1 Insertion", &settings->rodHeight_1, 1, 100);
-    ImGui::SliderFloat("Rod 2 Insertion", &settings->rodHeight_2, 1, 100);
-    ImGui::SliderFloat("Rod 3 Insertion", &settings->rodHeight_3, 1, 100);
-    ImGui::SliderFloat("Rod 4 Insertion", &settings->rodHeight_4, 1, 100);
-    ImGui::SliderFloat("Rod 5 Insertion", &settings->rodHeight_5, 1, 100);
+    for (int b = 0; b < banks; b++) {
+        char label[32];
+        snprintf(label, sizeof(label), "Bank %d Insertion", b + 1);
+        ImGui::SliderFloat(label, &bankHeight[b], 1, 100);
+    }
     ImGui::EndDisabled();
     ImGui::Separator();
     ImGui::BeginDisabled(!automode);
@@ -184,33 +249,32 @@ void renderEngine::Update()
     ImGui::EndDisabled();
     ImGui::End();
 
-    if (automode) {
+    if (automode && banks > 0) {
         global = true;
         if (useController) {
-            float signal = controller.Calculate(*neutronCount, NE_DELTATIME, controller_Kp, controller_Ki, controller_Kd);
-            settings->rodHeight_1 -= signal * NE_DELTATIME;
+            float signal = controller.Calculate(frame.neutronCount, NE_DELTATIME, controller_Kp, controller_Ki, controller_Kd);
+            bankHeight[0] -= signal * NE_DELTATIME;
         } else {
             // Use basic automode
-            if (*neutronCount < automode_goal) {
+            if (frame.neutronCount < automode_goal) {
 
-                settings->rodHeight_1 -= automode_speed * NE_DELTATIME;
-            } else if (*neutronCount > automode_goal) {
-                settings->rodHeight_1 += automode_speed * NE_DELTATIME;
+                bankHeight[0] -= automode_speed * NE_DELTATIME;
+            } else if (frame.neutronCount > automode_goal) {
+                bankHeight[0] += automode_speed * NE_DELTATIME;
             }
 
-            if (settings->rodHeight_1 > 100) {
-                settings->rodHeight_1 = 100;
-            } else if (settings->rodHeight_1 < automode_maxheight) {
-                settings->rodHeight_1 = automode_maxheight;
+            if (bankHeight[0] > 100) {
+                bankHeight[0] = 100;
+            } else if (bankHeight[0] < automode_maxheight) {
+                bankHeight[0] = automode_maxheight;
             }
         }
     }
-    // Set all rods
+    // Set all banks
     if (global) {
-        settings->rodHeight_2 = settings->rodHeight_1;
-        settings->rodHeight_3 = settings->rodHeight_1;
-        settings->rodHeight_4 = settings->rodHeight_1;
-        settings->rodHeight_5 = settings->rodHeight_1;
+        for (int b = 1; b < banks; b++) {
+            bankHeight[b] = bankHeight[0];
+        }
     }
 
     // Neutron Summoner
@@ -258,101 +322,107 @@ void renderEngine::Update()
     // Primary Renderer
     ImGui::Begin("Nuclear Reactor", NULL,
         ImGuiWindowFlags_NoResize | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoCollapse);
-    ImVec2 p = ImGui::GetCursorScreenPos();
-    ImGui::GetWindowDrawList()->AddRectFilled(
-        ImVec2(p.x, p.y), ImVec2(p.x + (NR_SIZE_X * RR_SCALE), p.y + (NR_SIZE_Y * RR_SCALE)),
-        IM_COL32(255, 255, 255, 255));
-
-    // Draw Reactor Water
-    for (int i = 0; i < waterRef->size(); i++) {
-        auto col = IM_COL32((*waterRef)[i].colourID, 20, 255 - (*waterRef)[i].colourID, 255);
-        if ((*waterRef)[i].colourID == -1) {
-            col = IM_COL32(0, 0, 0, 0);
-        }
+    ImGui::RadioButton("Auto", &coreViewMode, 0);
+    ImGui::SameLine();
+    ImGui::RadioButton("Primitives", &coreViewMode, 1);
+    ImGui::SameLine();
+    ImGui::RadioButton("Texture", &coreViewMode, 2);
+    bool textureView = coreViewMode == 2 || (coreViewMode == 0 && frame.sizeX * frame.sizeY > RR_RASTER_MIN_CELLS);
+    if (textureView) {
+        CoreTexture(frame, freshFrame);
+    } else {
+        ImVec2 p = ImGui::GetCursorScreenPos();
         ImGui::GetWindowDrawList()->AddRectFilled(
-            ImVec2(p.x + ((*waterRef)[i].position.x - ((*waterRef)[i].size.x / 1)), p.y + ((*waterRef)[i].position.y - ((*waterRef)[i].size.y / 1))), ImVec2(p.x + ((*waterRef)[i].position.x + ((*waterRef)[i].size.x / 1)), p.y + ((*waterRef)[i].position.y + ((*waterRef)[i].size.y / 1))),
-            col);
-    }
-
-    // Draw Reactor Materials
-    for (int i = 0; i < reactorMaterialRef->size(); i++) {
-        auto col = IM_COL32(0, 0, 0, 255);
-        if ((*reactorMaterialRef)[i].colourID == 0) {
-            col = IM_COL32(200, 200, 200, 255);
-        } else if ((*reactorMaterialRef)[i].colourID == 1) {
-            col = IM_COL32(100, 200, 100, 255);
-        } else if ((*reactorMaterialRef)[i].colourID == 2) {
-            col = IM_COL32(50, 50, 50, 255);
+            ImVec2(p.x, p.y), ImVec2(p.x + coreSize.x, p.y + coreSize.y),
+            IM_COL32(255, 255, 255, 255));
+
+        // Draw Reactor Water
+        for (int i = 0; i < waterRef->size(); i++) {
+            auto col = IM_COL32((*waterRef)[i].colourID, 20, 255 - (*waterRef)[i].colourID, 255);
+            if ((*waterRef)[i].colourID == -1) {
+                col = IM_COL32(0, 0, 0, 0);
+            }
+            ImGui::GetWindowDrawList()->AddRectFilled(
+                ImVec2(p.x + ((*waterRef)[i].position.x - ((*waterRef)[i].size.x / 1)), p.y + ((*waterRef)[i].position.y - ((*waterRef)[i].size.y / 1))), ImVec2(p.x + ((*waterRef)[i].position.x + ((*waterRef)[i].size.x / 1)), p.y + ((*waterRef)[i].position.y + ((*waterRef)[i].size.y / 1))),
+                col);
         }
-        ImGui::GetWindowDrawList()->AddCircleFilled(
-            ImVec2(p.x + (*reactorMaterialRef)[i].position.x,
-                p.y + (*reactorMaterialRef)[i].position.y),
-            (*reactorMaterialRef)[i].radius, col, 0);
-    }
 
-    // Draw Neutrons
-    for (int i = 0; i < neturonRef->size(); i++) {
-        auto col = IM_COL32(50, 50, 50, 255);
-        if ((*neturonRef)[i].colourID == 1) {
-            col = IM_COL32(100, 100, 100, 255);
+        // Draw Reactor Materials
+        for (int i = 0; i < reactorMaterialRef->size(); i++) {
+            auto col = IM_COL32(0, 0, 0, 255);
+            if ((*reactorMaterialRef)[i].colourID == 0) {
+                col = IM_COL32(200, 200, 200, 255);
+            } else if ((*reactorMaterialRef)[i].colourID == 1) {
+                col = IM_COL32(100, 200, 100, 255);
+            } else if ((*reactorMaterialRef)[i].colourID == 2) {
+                col = IM_COL32(50, 50, 50, 255);
+            }
+            ImGui::GetWindowDrawList()->AddCircleFilled(
+                ImVec2(p.x + (*reactorMaterialRef)[i].position.x,
+                    p.y + (*reactorMaterialRef)[i].position.y),
+                (*reactorMaterialRef)[i].radius, col, 0);
         }
-        ImGui::GetWindowDrawList()->AddCircleFilled(
-            ImVec2(p.x + (*neturonRef)[i].position.x,
-                p.y + (*neturonRef)[i].position.y),
-            (*neturonRef)[i].radius, col, 0);
-    }
 
-    // Draw Reactor rods
-    for (int i = 0; i < rodRef->size(); i++) {
-        auto col = IM_COL32(50, 50, 50, 255);
-        if ((*rodRef)[i].colourID == 1) {
-            col = IM_COL32(100, 100, 100, 255);
+        // Draw Neutrons
+        for (int i = 0; i < neturonRef->size(); i++) {
+            auto col = IM_COL32(50, 50, 50, 255);
+            if ((*neturonRef)[i].colourID == 1) {
+                col = IM_COL32(100, 100, 100, 255);
+            }
+            ImGui::GetWindowDrawList()->AddCircleFilled(
+                ImVec2(p.x + (*neturonRef)[i].position.x,
+                    p.y + (*neturonRef)[i].position.y),
+                (*neturonRef)[i].radius, col, 0);
         }
-        if ((*rodRef)[i].colourID == -1) {
-            col = IM_COL32(200, 200, 200, 255);
+
+        // Draw Reactor rods
+        for (int i = 0; i < rodRef->size(); i++) {
+            auto col = IM_COL32(50, 50, 50, 255);
+            if ((*rodRef)[i].colourID == 1) {
+                col = IM_COL32(100, 100, 100, 255);
+            }
+            if ((*rodRef)[i].colourID == -1) {
+                col = IM_COL32(200, 200, 200, 255);
+            }
+            ImGui::GetWindowDrawList()->AddRectFilled(
+                ImVec2(p.x + ((*rodRef)[i].position.x - ((*rodRef)[i].size.x / 2)), p.y + ((*rodRef)[i].position.y - ((*rodRef)[i].size.y / 2))), ImVec2(p.x + ((*rodRef)[i].position.x + ((*rodRef)[i].size.x / 2)), p.y + ((*rodRef)[i].position.y + ((*rodRef)[i].size.y / 2))),
+                col);
         }
-        ImGui::GetWindowDrawList()->AddRectFilled(
-            ImVec2(p.x + ((*rodRef)[i].position.x - ((*rodRef)[i].size.x / 2)), p.y + ((*rodRef)[i].position.y - ((*rodRef)[i].size.y / 2))), ImVec2(p.x + ((*rodRef)[i].position.x + ((*rodRef)[i].size.x / 2)), p.y + ((*rodRef)[i].position.y + ((*rodRef)[i].size.y / 2))),
-            col);
+        ImGui::Dummy(ImVec2(coreSize.x, coreSize.y));
     }
-    ImGui::Dummy(ImVec2((NR_SIZE_X * RR_SCALE), (NR_SIZE_Y * RR_SCALE)));
     ImGui::End();
 
     // Data Output
     ImGui::Begin("Data", NULL);
+    // Exact current values, maintained by the engine so they are free to show every frame
+    ImGui::Text("Neutrons %lld (%lld fast, %lld thermal)  Xenon %d", (long long)frame.neutronCount, (long long)frame.fastCount,
+        (long long)(frame.neutronCount - frame.fastCount), frame.xenonCount);
+    ImGui::Text("Temperature avg %.2f  max %.2f", frame.averageTemperature, frame.maxTemperature);
+    if (frame.continuum) {
+        ImGui::Text("Continuum flux field (neutrons are not drawn)");
+    } else if (frame.packetCount != frame.neutronCount) {
+        ImGui::Text("Packets %d", frame.packetCount);
+    }
+    ImGui::SliderInt("Sample Every (ticks)", &settings->statInterval, 1, NE_TARGET_TICKRATE);
     if (ImPlot::BeginPlot("Data Output")) {
-        // float time[settings->particle.GetMax()];
-        static std::vector<float> time(settings->stats.GetMax());
-        for (int i = 0; i < settings->stats.GetMax(); i++) {
-            time[i] = i;
-        }
-        static std::vector<float> data(settings->stats.GetMax());
-        for (int i = 0; i < settings->stats.GetMax(); i++) {
-            data[i] = settings->stats.GetReactivityStats()[i];
-        }
-        static std::vector<float> data1(settings->stats.GetMax());
-        for (int i = 0; i < settings->stats.GetMax(); i++) {
-            data1[i] = settings->stats.GetXenonStats()[i];
-        }
-        static std::vector<float> data2(settings->stats.GetMax());
-        for (int i = 0; i < settings->stats.GetMax(); i++) {
-            data2[i] = settings->stats.GetTempStats()[i];
-        }
-
-        ImPlot::PlotLine("Reactivity", &time[0], &data[0],
-            settings->stats.GetMax());
-        ImPlot::PlotLine("Xenon", &time[0], &data1[0],
-            settings->stats.GetMax());
-        ImPlot::PlotLine("Average Temperature", &time[0], &data2[0],
-            settings->stats.GetMax());
+        // Plot straight from the statistics rings
+        statView<int64_t> reactivity = settings->stats.GetReactivityStats();
+        statView<int> xenon = settings->stats.GetXenonStats();
+        statView<float> temperature = settings->stats.GetTempStats();
+        ImPlot::PlotLineG("Reactivity", StatGetter<int64_t>, &reactivity, reactivity.Count());
+        ImPlot::PlotLineG("Xenon", StatGetter<int>, &xenon, xenon.Count());
+        ImPlot::PlotLineG("Average Temperature", StatGetter<float>, &temperature, temperature.Count());
         ImPlot::EndPlot();
     }
     ImGui::End();
+
+    ProfilerPanel();
 }
 
 // Render
 void renderEngine::Render()
 {
+    NE_PROFILE_SCOPE("renderEngine::Render");
     // Imgui Render
     ImGui::Render();
 
@@ -368,6 +438,9 @@ void renderEngine::Render()
 // Clean
 void renderEngine::Clean()
 {
+    if (coreTexture != 0) {
+        glDeleteTextures(1, &coreTexture);
+    }
     // Shutdown imgui graphic implementation
     ImGui_ImplOpenGL3_Shutdown();
     // Clean Imgui
@@ -380,3 +453,114 @@ void renderEngine::Clean()
     SDL_Quit();
     std::cout << "Engine Cleaned!" << std::endl;
 }
+
+// Draw the core as one texture (rasterized on the CPU, re-uploaded only when a new frame arrives)
+void renderEngine::CoreTexture(const RenderSnapshot& frame, bool freshFrame)
+{
+    if (frame.sizeX <= 0 || frame.sizeY <= 0) {
+        return;
+    }
+    int cellPixels = coreRaster::CellPixels(frame.sizeX, frame.sizeY);
+    bool resized = frame.sizeX * cellPixels != coreTextureWidth || frame.sizeY * cellPixels != coreTextureHeight;
+    if (freshFrame || resized || coreTexture == 0) {
+        coreImage.Draw(frame, cellPixels);
+        if (coreTexture == 0) {
+            glGenTextures(1, &coreTexture);
+        }
+        glBindTexture(GL_TEXTURE_2D, coreTexture);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        if (resized) {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, coreImage.Width(), coreImage.Height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, coreImage.Pixels());
+            coreTextureWidth = coreImage.Width();
+            coreTextureHeight = coreImage.Height();
+        } else {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, coreImage.Width(), coreImage.Height(), GL_RGBA, GL_UNSIGNED_BYTE, coreImage.Pixels());
+        }
+    }
+
+    // Same scale as the primitive view, shrunk to fit large cores on screen
+    float cellSize = std::min((float)RR_SCALE, (float)RR_RASTER_VIEW / std::max(frame.sizeX, frame.sizeY));
+    ImGui::Image((ImTextureID)(intptr_t)coreTexture, ImVec2(frame.sizeX * cellSize, frame.sizeY * cellSize));
+};
+
+// Per-phase frame cost and trace export
+void renderEngine::ProfilerPanel()
+{
+    // Record this frame (ms)
+    profilerHead = (profilerHead + 1) % RR_PROFILE_HISTORY;
+    frameTimes[profilerHead] = ImGui::GetIO().DeltaTime * 1000;
+    frameCount = std::min(frameCount + 1, RR_PROFILE_HISTORY);
+    for (int p = 0; p < profilerPhaseCount; p++) {
+        profilerHistory[p][profilerHead] = 0;
+    }
+    if (profilerEnabled) {
+        profilerEvents.clear();
+        profiler::Collect(&profilerEvents, profilerLastCollect);
+        for (int i = 0; i < profilerEvents.size(); i++) {
+            for (int p = 0; p < profilerPhaseCount; p++) {
+                if (strcmp(profilerEvents[i].zone, profilerPhases[p]) == 0) {
+                    profilerHistory[p][profilerHead] += (profilerEvents[i].end - profilerEvents[i].start) / 1e6;
+                    break;
+                }
+            }
+        }
+    }
+    profilerLastCollect = profiler::Now();
+
+    ImGui::Begin("Profiler", NULL);
+    if (ImGui::Checkbox("Enabled", &profilerEnabled)) {
+        profiler::SetEnabled(profilerEnabled);
+    }
+
+    // Frame time percentiles
+    float sorted[RR_PROFILE_HISTORY];
+    for (int i = 0; i < frameCount; i++) {
+        sorted[i] = frameTimes[(profilerHead - i + RR_PROFILE_HISTORY) % RR_PROFILE_HISTORY];
+    }
+    std::sort(sorted, sorted + frameCount);
+    int p99 = std::min(frameCount - 1, (frameCount * 99) / 100);
+    ImGui::SameLine();
+    ImGui::Text("Frame p50 %.2f ms  p99 %.2f ms", sorted[frameCount / 2], sorted[p99]);
+
+    // Stacked phase times, oldest frame first
+    if (ImPlot::BeginPlot("Frame Phases (ms)")) {
+        ImPlot::SetupAxes("Frame", "ms", 0, ImPlotAxisFlags_AutoFit);
+        ImPlot::SetupAxisLimits(ImAxis_X1, 0, RR_PROFILE_HISTORY, ImPlotCond_Always);
+        float xs[RR_PROFILE_HISTORY];
+        float lower[RR_PROFILE_HISTORY] = {};
+        float upper[RR_PROFILE_HISTORY];
+        for (int i = 0; i < RR_PROFILE_HISTORY; i++) {
+            xs[i] = i;
+        }
+        for (int p = 0; p < profilerPhaseCount; p++) {
+            for (int i = 0; i < RR_PROFILE_HISTORY; i++) {
+                int frame = (profilerHead + 1 + i) % RR_PROFILE_HISTORY;
+                upper[i] = lower[i] + profilerHistory[p][frame];
+            }
+            ImPlot::PlotShaded(profilerPhases[p], xs, lower, upper, RR_PROFILE_HISTORY);
+            std::copy(upper, upper + RR_PROFILE_HISTORY, lower);
+        }
+        ImPlot::EndPlot();
+    }
+
+    // Chrome trace (open in chrome://tracing or Perfetto)
+    ImGui::SliderFloat("Trace Seconds", &profilerTraceSeconds, 1, 30);
+    ImGui::BeginDisabled(!profilerEnabled);
+    if (ImGui::Button("Export Trace")) {
+        if (profiler::WriteChromeTrace("trace.json", profilerTraceSeconds)) {
+            profilerStatus = "Wrote trace.json";
+        } else {
+            profilerStatus = "Could not write trace.json";
+        }
+    }
+    ImGui::EndDisabled();
+    if (!profilerStatus.empty()) {
+        ImGui::SameLine();
+        ImGui::Text("%s", profilerStatus.c_str());
+    }
+    ImGui::End();
+}
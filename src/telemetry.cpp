@@ -0,0 +1,187 @@
+#include "../include/telemetry.h"
+
+#include <algorithm>
+#include <chrono>
+
+// Start writer thread
+bool telemetrySink::Open(const std::string& base, telemetryFormat format, int decimationTicks, long long rotate)
+{
+    Close();
+    basePath = base;
+    fileFormat = format;
+    decimation = decimationTicks > 0 ? decimationTicks : 1;
+    rotateBytes = rotate;
+    fileIndex = 0;
+    dropped = 0;
+    written = 0;
+    // Discard anything pushed after the last close
+    telemetrySample stale;
+    while (queue.TryPop(&stale)) { }
+    if (!OpenFile()) {
+        return false;
+    }
+    running.store(true, std::memory_order_release);
+    writer = std::thread(&telemetrySink::WriterLoop, this);
+    return true;
+};
+
+// Stop writer thread, everything queued so far is written
+void telemetrySink::Close()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+    writer.join();
+};
+
+// Drain queue until closed
+void telemetrySink::WriterLoop()
+{
+    telemetrySample sample;
+    while (true) {
+        bool stopping = !running.load(std::memory_order_acquire);
+        bool any = false;
+        while (queue.TryPop(&sample)) {
+            WriteSample(sample);
+            any = true;
+        }
+        if (stopping) {
+            break;
+        }
+        if (!any) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+    CloseFile();
+};
+
+// Open next file in the rotation
+bool telemetrySink::OpenFile()
+{
+    char name[32];
+    snprintf(name, sizeof(name), "_%04d%s", fileIndex, fileFormat == TELEMETRY_CSV ? ".csv" : ".bin");
+    file = fopen((basePath + name).c_str(), fileFormat == TELEMETRY_CSV ? "w" : "wb");
+    if (file == nullptr) {
+        printf("Telemetry: could not write %s%s\n", basePath.c_str(), name);
+        return false;
+    }
+    fileIndex++;
+    fileBytes = 0;
+    fileBanks = -1;
+    return true;
+};
+
+// Column header, one column per rod bank (written with the first sample of a file)
+void telemetrySink::WriteHeader(int banks)
+{
+    fileBanks = banks;
+    if (fileFormat == TELEMETRY_CSV) {
+        fileBytes += fprintf(file, "tick,neutrons,fast,thermal,xenon,average_temperature,max_temperature");
+        for (int b = 0; b < banks; b++) {
+            fileBytes += fprintf(file, ",bank_%d", b + 1);
+        }
+        fileBytes += fprintf(file, ",fissions\n");
+    } else {
+        const char magic[8] = "NIPTLM1";
+        uint32_t version = 3;
+        uint32_t columns = banks;
+        fwrite(magic, 1, sizeof(magic), file);
+        fwrite(&version, sizeof(version), 1, file);
+        fwrite(&columns, sizeof(columns), 1, file);
+        fileBytes += sizeof(magic) + sizeof(version) + sizeof(columns);
+    }
+};
+
+void telemetrySink::CloseFile()
+{
+    if (file == nullptr) {
+        return;
+    }
+    FlushBlock();
+    fclose(file);
+    file = nullptr;
+};
+
+// Write or buffer one sample, rotating when the file is full
+void telemetrySink::WriteSample(const telemetrySample& s)
+{
+    if (file == nullptr) {
+        return;
+    }
+    int banks = std::min(std::max(s.banks, 0), NR_MAX_ROD_BANKS);
+    if (banks != fileBanks) {
+        if (fileBanks >= 0) {
+            CloseFile();
+            if (!OpenFile()) {
+                return;
+            }
+        }
+        WriteHeader(banks);
+    }
+    if (fileFormat == TELEMETRY_CSV) {
+        fileBytes += fprintf(file, "%lld,%lld,%lld,%lld,%d,%.3f,%.3f", (long long)s.tick, (long long)s.neutrons, (long long)s.fast, (long long)s.thermal, s.xenon,
+            s.averageTemperature, s.maxTemperature);
+        for (int b = 0; b < banks; b++) {
+            fileBytes += fprintf(file, ",%.2f", s.bankHeight[b]);
+        }
+        fileBytes += fprintf(file, ",%lld\n", (long long)s.fissions);
+    } else {
+        block.push_back(s);
+        if (block.size() >= NR_TELEMETRY_BLOCK) {
+            FlushBlock();
+        }
+    }
+    written.fetch_add(1, std::memory_order_relaxed);
+
+    if (rotateBytes > 0 && fileBytes >= rotateBytes) {
+        CloseFile();
+        OpenFile();
+    }
+};
+
+// Write buffered samples as one columnar block
+void telemetrySink::FlushBlock()
+{
+    if (block.empty()) {
+        return;
+    }
+    uint32_t rows = block.size();
+    uint32_t reserved = 0;
+    fwrite(&rows, sizeof(rows), 1, file);
+    fwrite(&reserved, sizeof(reserved), 1, file);
+    std::vector<int64_t> wide(rows);
+    std::vector<int32_t> whole(rows);
+    std::vector<float> real(rows);
+    // 64-bit columns
+    int64_t telemetrySample::*wides[] = { &telemetrySample::tick, &telemetrySample::neutrons, &telemetrySample::fast, &telemetrySample::thermal };
+    for (int64_t telemetrySample::*column : wides) {
+        for (uint32_t i = 0; i < rows; i++) {
+            wide[i] = block[i].*column;
+        }
+        fwrite(wide.data(), sizeof(int64_t), rows, file);
+    }
+    for (uint32_t i = 0; i < rows; i++) {
+        whole[i] = block[i].xenon;
+    }
+    fwrite(whole.data(), sizeof(int32_t), rows, file);
+    // Float columns
+    float telemetrySample::*reals[] = { &telemetrySample::averageTemperature, &telemetrySample::maxTemperature };
+    for (float telemetrySample::*column : reals) {
+        for (uint32_t i = 0; i < rows; i++) {
+            real[i] = block[i].*column;
+        }
+        fwrite(real.data(), sizeof(float), rows, file);
+    }
+    for (int b = 0; b < fileBanks; b++) {
+        for (uint32_t i = 0; i < rows; i++) {
+            real[i] = block[i].bankHeight[b];
+        }
+        fwrite(real.data(), sizeof(float), rows, file);
+    }
+    for (uint32_t i = 0; i < rows; i++) {
+        wide[i] = block[i].fissions;
+    }
+    fwrite(wide.data(), sizeof(int64_t), rows, file);
+    fileBytes += 8 + rows * (sizeof(int64_t) * 5 + sizeof(int32_t) + sizeof(float) * (2 + fileBanks));
+    block.clear();
+};
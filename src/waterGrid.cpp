@@ -0,0 +1,267 @@
+#include "../include/waterGrid.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define WATER_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define WATER_AVX2_TARGET
+#else
+#define WATER_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+// Cells per worker chunk
+#define WATER_CHUNK_CELLS 16384
+// Explicit neighbour exchange is only stable up to half the difference per step
+#define WATER_MAX_FLOW 0.5f
+
+// Stencil parameters shared by kernels
+struct waterStep {
+    const float* in;
+    const float* heat;
+    float* out;
+    int width;
+    int height;
+    float dissipate;
+    float flow;
+    float inlet;
+};
+
+// Dissipation, heating and inlet for one cell before flow
+static inline float LocalTemperature(const waterStep* s, int i, int y)
+{
+    if (y == s->height - 1) {
+        return s->inlet;
+    }
+    float t = s->in[i];
+    t = t > 0 ? t - s->dissipate : 0;
+    return t + s->heat[i];
+}
+
+// Portable kernel for rows [y0, y1), also reduces the written cells into sum and max
+static void StepRowsScalar(const waterStep* s, int y0, int y1, double* sum, float* max)
+{
+    double total = 0;
+    float hottest = std::numeric_limits<float>::lowest();
+    for (int y = y0; y < y1; y++) {
+        float up = y > 0 ? s->flow : 0;
+        float down = y < s->height - 1 ? s->flow : 0;
+        for (int x = 0; x < s->width; x++) {
+            int i = x + y * s->width;
+            float t = LocalTemperature(s, i, y);
+            float out = t * (1 - up - down);
+            if (up != 0) {
+                out += up * LocalTemperature(s, i - s->width, y - 1);
+            }
+            if (down != 0) {
+                out += down * LocalTemperature(s, i + s->width, y + 1);
+            }
+            s->out[i] = out;
+            total += out;
+            hottest = std::max(hottest, out);
+        }
+    }
+    *sum = total;
+    *max = hottest;
+}
+
+#ifdef WATER_X86
+// Eight cells of one row before flow
+WATER_AVX2_TARGET static inline __m256 LocalTemperature8(const waterStep* s, int i, int y)
+{
+    if (y == s->height - 1) {
+        return _mm256_set1_ps(s->inlet);
+    }
+    __m256 t = _mm256_loadu_ps(s->in + i);
+    __m256 positive = _mm256_cmp_ps(t, _mm256_setzero_ps(), _CMP_GT_OQ);
+    t = _mm256_and_ps(_mm256_sub_ps(t, _mm256_set1_ps(s->dissipate)), positive);
+    return _mm256_add_ps(t, _mm256_loadu_ps(s->heat + i));
+}
+
+// AVX2 kernel for rows [y0, y1), scalar tail per row
+// Sums are widened to double lanes so large grids do not lose precision
+WATER_AVX2_TARGET static void StepRowsAVX2(const waterStep* s, int y0, int y1, double* sum, float* max)
+{
+    __m256d totalLow = _mm256_setzero_pd();
+    __m256d totalHigh = _mm256_setzero_pd();
+    __m256 hottest8 = _mm256_set1_ps(std::numeric_limits<float>::lowest());
+    double total = 0;
+    float hottest = std::numeric_limits<float>::lowest();
+    for (int y = y0; y < y1; y++) {
+        float up = y > 0 ? s->flow : 0;
+        float down = y < s->height - 1 ? s->flow : 0;
+        __m256 self = _mm256_set1_ps(1 - up - down);
+        __m256 upWeight = _mm256_set1_ps(up);
+        __m256 downWeight = _mm256_set1_ps(down);
+        int x = 0;
+        for (; x + 8 <= s->width; x += 8) {
+            int i = x + y * s->width;
+            __m256 out = _mm256_mul_ps(LocalTemperature8(s, i, y), self);
+            if (up != 0) {
+                out = _mm256_add_ps(out, _mm256_mul_ps(upWeight, LocalTemperature8(s, i - s->width, y - 1)));
+            }
+            if (down != 0) {
+                out = _mm256_add_ps(out, _mm256_mul_ps(downWeight, LocalTemperature8(s, i + s->width, y + 1)));
+            }
+            _mm256_storeu_ps(s->out + i, out);
+            totalLow = _mm256_add_pd(totalLow, _mm256_cvtps_pd(_mm256_castps256_ps128(out)));
+            totalHigh = _mm256_add_pd(totalHigh, _mm256_cvtps_pd(_mm256_extractf128_ps(out, 1)));
+            hottest8 = _mm256_max_ps(hottest8, out);
+        }
+        for (; x < s->width; x++) {
+            int i = x + y * s->width;
+            float out = LocalTemperature(s, i, y) * (1 - up - down);
+            if (up != 0) {
+                out += up * LocalTemperature(s, i - s->width, y - 1);
+            }
+            if (down != 0) {
+                out += down * LocalTemperature(s, i + s->width, y + 1);
+            }
+            s->out[i] = out;
+            total += out;
+            hottest = std::max(hottest, out);
+        }
+    }
+    double lanes[4];
+    float maxLanes[8];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(totalLow, totalHigh));
+    _mm256_storeu_ps(maxLanes, hottest8);
+    *sum = total + lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (int k = 0; k < 8; k++) {
+        hottest = std::max(hottest, maxLanes[k]);
+    }
+    *max = hottest;
+}
+#endif
+
+// Allocate grid
+void waterGrid::Resize(int w, int h)
+{
+    width = w;
+    height = h;
+    current.assign(w * h, 0);
+    next.assign(w * h, 0);
+    sum = 0;
+    max = 0;
+    maxStale = false;
+}
+
+// Write one cell
+void waterGrid::Set(int x, int y, float t)
+{
+    float& cell = current[x + y * width];
+    sum += (double)t - cell;
+    if (t >= max) {
+        max = t;
+        maxStale = false;
+    } else if (cell >= max) {
+        // Only a full pass can tell what the new max is, defer it to the next read
+        maxStale = true;
+    }
+    cell = t;
+}
+
+// Hottest cell
+float waterGrid::Max()
+{
+    if (maxStale) {
+        Refresh();
+    }
+    return max;
+}
+
+// Recompute aggregates from current
+void waterGrid::Refresh()
+{
+    sum = 0;
+    max = current.empty() ? 0 : std::numeric_limits<float>::lowest();
+    for (int i = 0; i < current.size(); i++) {
+        sum += current[i];
+        max = std::max(max, current[i]);
+    }
+    maxStale = false;
+}
+
+// Does this CPU support AVX2
+bool waterGrid::HasAVX2()
+{
+#if defined(WATER_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(WATER_X86)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+// Kernel used by Step
+waterKernel waterGrid::ActiveKernel() const
+{
+    static const bool avx2 = HasAVX2();
+    if (kernel == WATER_KERNEL_SCALAR || !avx2) {
+        return WATER_KERNEL_SCALAR;
+    }
+    return WATER_KERNEL_AVX2;
+}
+
+// Advance one step
+void waterGrid::Step(const float* heat, float dissipate, float flow, float inlet, workerPool* workers)
+{
+    if (Size() == 0) {
+        return;
+    }
+    waterStep s;
+    s.in = current.data();
+    s.heat = heat;
+    s.out = next.data();
+    s.width = width;
+    s.height = height;
+    s.dissipate = dissipate;
+    s.flow = std::min(std::max(flow, 0.0f), WATER_MAX_FLOW);
+    s.inlet = inlet;
+
+    void (*stepRows)(const waterStep*, int, int, double*, float*) = StepRowsScalar;
+#ifdef WATER_X86
+    if (ActiveKernel() == WATER_KERNEL_AVX2) {
+        stepRows = StepRowsAVX2;
+    }
+#endif
+
+    // Split by rows
+    int rowsPerChunk = std::max(1, WATER_CHUNK_CELLS / width);
+    int chunks = (height + rowsPerChunk - 1) / rowsPerChunk;
+    chunkSum.resize(chunks);
+    chunkMax.resize(chunks);
+    auto stepChunk = [&](int chunk) {
+        stepRows(&s, chunk * rowsPerChunk, std::min(height, (chunk + 1) * rowsPerChunk), &chunkSum[chunk], &chunkMax[chunk]);
+    };
+    if (workers == nullptr) {
+        for (int c = 0; c < chunks; c++) {
+            stepChunk(c);
+        }
+    } else {
+        workers->Run(chunks, stepChunk);
+    }
+    current.swap(next);
+
+    // Combine partials in chunk order, so the sum does not depend on the thread count
+    sum = 0;
+    max = std::numeric_limits<float>::lowest();
+    for (int c = 0; c < chunks; c++) {
+        sum += chunkSum[c];
+        max = std::max(max, chunkMax[c]);
+    }
+    maxStale = false;
+}
@@ -0,0 +1,99 @@
+#include "../include/workerPool.h"
+
+#include "../include/profiler.h"
+
+workerPool::workerPool()
+    : nextChunk(0) {};
+workerPool::~workerPool() { Stop(); };
+
+// Spawn workers
+void workerPool::Start(int threads)
+{
+    Stop();
+    if (threads <= 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    stopping = false;
+    // Calling thread counts as one worker
+    for (int i = 1; i < threads; i++) {
+        workers.push_back(std::thread(&workerPool::WorkerLoop, this));
+    }
+};
+
+// Join all workers
+void workerPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (int i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+    workers.clear();
+};
+
+// Run job across all threads
+void workerPool::Run(int chunks, const std::function<void(int)>& job)
+{
+    if (chunks <= 0) {
+        return;
+    }
+    // Not worth waking anyone
+    if (workers.empty() || chunks == 1) {
+        for (int i = 0; i < chunks; i++) {
+            job(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        currentJob = &job;
+        chunkCount = chunks;
+        nextChunk = 0;
+        activeWorkers = workers.size();
+        generation++;
+    }
+    wake.notify_all();
+
+    // Help out, then wait for stragglers
+    DoChunks();
+    std::unique_lock<std::mutex> guard(lock);
+    done.wait(guard, [this] { return activeWorkers == 0; });
+    currentJob = nullptr;
+};
+
+// Take chunks until none are left
+void workerPool::DoChunks()
+{
+    int chunk = nextChunk++;
+    while (chunk < chunkCount) {
+        (*currentJob)(chunk);
+        chunk = nextChunk++;
+    }
+};
+
+// Worker thread
+void workerPool::WorkerLoop()
+{
+    profiler::NameThread("Worker");
+    long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [this, seen] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+        DoChunks();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            activeWorkers--;
+        }
+        done.notify_one();
+    }
+};
@@ -0,0 +1,192 @@
+// Reduces an event log into per-cell heat maps
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../include/eventLog.h"
+#include "../include/mappedFile.h"
+
+static const char* typeNames[EVENT_TYPE_COUNT] = { "fission", "xenon", "rod", "water", "escape" };
+
+// Print usage
+void PrintHelp()
+{
+    printf("Usage: event-heatmap LOG [options]\n");
+    printf("  --out BASE     Write BASE_<type>.csv grids (default heatmap)\n");
+    printf("  --from N       First tick to count (default 0)\n");
+    printf("  --to N         Last tick to count (default all)\n");
+    printf("  --type NAME    Only this type: fission, xenon, rod, water or escape (default all)\n");
+    printf("  --pgm          Also write BASE_<type>.pgm images\n");
+};
+
+// Write grid as sizeY rows of sizeX counts
+bool WriteCsv(const std::string& path, const std::vector<uint32_t>& grid, int sizeX, int sizeY)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        printf("Could not write %s\n", path.c_str());
+        return false;
+    }
+    for (int y = 0; y < sizeY; y++) {
+        for (int x = 0; x < sizeX; x++) {
+            fprintf(file, x == 0 ? "%u" : ",%u", grid[y * sizeX + x]);
+        }
+        fprintf(file, "\n");
+    }
+    fclose(file);
+    return true;
+};
+
+// Write grid as 8-bit greyscale scaled to the hottest cell, top row is the top of the core
+bool WritePgm(const std::string& path, const std::vector<uint32_t>& grid, int sizeX, int sizeY)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        printf("Could not write %s\n", path.c_str());
+        return false;
+    }
+    uint32_t peak = 1;
+    for (int i = 0; i < grid.size(); i++) {
+        peak = grid[i] > peak ? grid[i] : peak;
+    }
+    fprintf(file, "P5\n%d %d\n255\n", sizeX, sizeY);
+    std::vector<uint8_t> row(sizeX);
+    for (int y = sizeY - 1; y >= 0; y--) {
+        for (int x = 0; x < sizeX; x++) {
+            row[x] = (uint8_t)((uint64_t)grid[y * sizeX + x] * 255 / peak);
+        }
+        fwrite(row.data(), 1, sizeX, file);
+    }
+    fclose(file);
+    return true;
+};
+
+// Entrypoint
+int main(int argc, char* args[])
+{
+    const char* logPath = nullptr;
+    std::string outBase = "heatmap";
+    uint32_t from = 0;
+    uint32_t to = UINT32_MAX;
+    int onlyType = -1;
+    bool pgm = false;
+
+    // Parse arguments
+    for (int i = 1; i < argc; i++) {
+        const char* arg = args[i];
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            PrintHelp();
+            return 0;
+        }
+        if (strcmp(arg, "--pgm") == 0) {
+            pgm = true;
+            continue;
+        }
+        if (arg[0] != '-') {
+            logPath = arg;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            printf("Missing value for %s\n", arg);
+            return 1;
+        }
+        const char* value = args[++i];
+        if (strcmp(arg, "--out") == 0) {
+            outBase = value;
+        } else if (strcmp(arg, "--from") == 0) {
+            from = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--to") == 0) {
+            to = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--type") == 0) {
+            for (int t = 0; t < EVENT_TYPE_COUNT; t++) {
+                if (strcmp(value, typeNames[t]) == 0) {
+                    onlyType = t;
+                }
+            }
+            if (onlyType < 0) {
+                printf("Unknown event type %s\n", value);
+                return 1;
+            }
+        } else {
+            printf("Unknown option %s\n", arg);
+            PrintHelp();
+            return 1;
+        }
+    }
+    if (logPath == nullptr) {
+        PrintHelp();
+        return 1;
+    }
+
+    // Validate header
+    mappedFile file;
+    if (!file.Open(logPath)) {
+        printf("Could not read %s\n", logPath);
+        return 1;
+    }
+    eventLogHeader header;
+    if (file.Size() < sizeof(header)) {
+        printf("%s is not an event log\n", logPath);
+        return 1;
+    }
+    memcpy(&header, file.Data(), sizeof(header));
+    if (memcmp(header.magic, NR_EVENT_MAGIC, sizeof(header.magic)) != 0 || header.version != NR_EVENT_VERSION) {
+        printf("%s is not an event log (or a different version)\n", logPath);
+        return 1;
+    }
+    if (header.sizeX <= 0 || header.sizeY <= 0 || header.sizeX - 1 > NR_EVENT_MAX_COORD || header.sizeY - 1 > NR_EVENT_MAX_COORD) {
+        printf("%s has an invalid core size\n", logPath);
+        return 1;
+    }
+    int sizeX = header.sizeX;
+    int sizeY = header.sizeY;
+    size_t count = (file.Size() - sizeof(header)) / sizeof(eventRecord);
+    const eventRecord* records = (const eventRecord*)(file.Data() + sizeof(header));
+
+    // Accumulate
+    std::vector<std::vector<uint32_t>> grids(EVENT_TYPE_COUNT, std::vector<uint32_t>(sizeX * sizeY, 0));
+    long long totals[EVENT_TYPE_COUNT] = { 0 };
+    long long fastTotals[EVENT_TYPE_COUNT] = { 0 };
+    uint32_t firstTick = UINT32_MAX;
+    uint32_t lastTick = 0;
+    for (size_t i = 0; i < count; i++) {
+        eventRecord e;
+        memcpy(&e, &records[i], sizeof(e));
+        int type = e.Type();
+        if (e.tick < from || e.tick > to || type >= EVENT_TYPE_COUNT || (onlyType >= 0 && type != onlyType)) {
+            continue;
+        }
+        if (e.X() >= sizeX || e.Y() >= sizeY) {
+            continue;
+        }
+        grids[type][e.Y() * sizeX + e.X()]++;
+        totals[type]++;
+        fastTotals[type] += e.Fast();
+        firstTick = e.tick < firstTick ? e.tick : firstTick;
+        lastTick = e.tick > lastTick ? e.tick : lastTick;
+    }
+
+    // Report
+    printf("Log: %s (%dx%d, %zu events)\n", logPath, sizeX, sizeY, count);
+    if (firstTick <= lastTick) {
+        printf("Ticks: %u - %u\n", firstTick, lastTick);
+    }
+    for (int t = 0; t < EVENT_TYPE_COUNT; t++) {
+        if (onlyType >= 0 && t != onlyType) {
+            continue;
+        }
+        printf("%-8s %10lld (%lld fast)\n", typeNames[t], totals[t], fastTotals[t]);
+        std::string base = outBase + "_" + typeNames[t];
+        if (!WriteCsv(base + ".csv", grids[t], sizeX, sizeY)) {
+            return 1;
+        }
+        if (pgm && !WritePgm(base + ".pgm", grids[t], sizeX, sizeY)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,251 @@
+// Headless batch runner for the fluid engine
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../include/core.h"
+#include "../include/fluidEngine.h"
+#include "../include/profiler.h"
+
+// Print usage
+void PrintHelp()
+{
+    printf("Usage: reactor-sim [options]\n");
+    printf("  --ticks N              Ticks to simulate (default 3600)\n");
+    printf("  --seed N               Random seed (default 1)\n");
+    printf("  --enrichment F         U-235 fraction of initial core (default %g)\n", NR_ENRICHMENT);
+    printf("  --neutrons N           Initial fast neutrons (default 10)\n");
+    printf("  --size WxH             Core size in lattice cells (default %dx%d)\n", NR_DEFAULT_SIZE_X, NR_DEFAULT_SIZE_Y);
+    printf("  --threads N            Neutron transport threads (default 0 = all cores)\n");
+    printf("  --transport MODE       step (move by velocity * dt) or dda (walk every cell crossed, default step)\n");
+    printf("  --rods F               Movable control rod insertion 1-100 (default 100)\n");
+    printf("  --weighted N           Weighted transport, keeping about N neutron packets (default off)\n");
+    printf("  --flux MODE            auto (flux field above --continuum-above neutrons), particles or continuum (default auto)\n");
+    printf("  --continuum-above N    Switch to the flux field above N neutrons (default 250000)\n");
+    printf("  --continuum-below N    Switch back to particles below N neutrons (default 100000)\n");
+    printf("  --fission-count N      Neutrons released per fission\n");
+    printf("  --fission-speed F      Thermal neutron speed\n");
+    printf("  --fast-speed F         Fast neutron speed\n");
+    printf("  --decay F              Spontaneous neutron emission chance\n");
+    printf("  --absorption F         Water neutron absorption chance\n");
+    printf("  --xenon-decay F        Xenon decay chance\n");
+    printf("  --dissipate F          Water heat dissipation speed\n");
+    printf("  --heat-transfer F      Neutron to water heat transfer speed\n");
+    printf("  --flow F               Water flow rate\n");
+    printf("  --load FILE            Start from a checkpoint instead of a new core (--size and --enrichment are ignored)\n");
+    printf("  --save FILE            Write a checkpoint after the run\n");
+    printf("  --telemetry BASE       Record per-tick metrics to BASE_0000.csv (or .bin)\n");
+    printf("  --telemetry-format F   csv or bin (columnar binary, default csv)\n");
+    printf("  --telemetry-every N    Keep one sample every N ticks (default 1)\n");
+    printf("  --telemetry-rotate MB  Start a new file past MB megabytes (default 0 = never)\n");
+    printf("  --events FILE          Log fissions, absorptions and escapes (see event-heatmap)\n");
+    printf("  --trace FILE           Profile the run and write the last 10 s as a Chrome trace\n");
+}
+
+// Entrypoint
+int main(int argc, char* args[])
+{
+    long ticks = 3600;
+    uint64_t seed = NR_DEFAULT_SEED;
+    float enrichment = NR_ENRICHMENT;
+    int initialNeutrons = 10;
+    float rodHeight = 100;
+    ReactorGeometry geometry;
+    const char* tracePath = nullptr;
+    const char* loadPath = nullptr;
+    const char* savePath = nullptr;
+    const char* telemetryBase = nullptr;
+    telemetryFormat telemetryType = TELEMETRY_CSV;
+    int telemetryEvery = 1;
+    double telemetryRotate = 0;
+    const char* eventPath = nullptr;
+    profiler::NameThread("Main");
+    fluidEngine* fluid = new fluidEngine();
+
+    // Parse arguments
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(args[i], "--help") == 0 || strcmp(args[i], "-h") == 0) {
+            PrintHelp();
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            printf("Missing value for %s\n", args[i]);
+            return 1;
+        }
+        const char* arg = args[i];
+        const char* value = args[++i];
+        if (strcmp(arg, "--ticks") == 0) {
+            ticks = atol(value);
+        } else if (strcmp(arg, "--seed") == 0) {
+            seed = strtoull(value, nullptr, 10);
+        } else if (strcmp(arg, "--enrichment") == 0) {
+            enrichment = atof(value);
+        } else if (strcmp(arg, "--neutrons") == 0) {
+            initialNeutrons = atoi(value);
+        } else if (strcmp(arg, "--size") == 0) {
+            if (sscanf(value, "%dx%d", &geometry.sizeX, &geometry.sizeY) != 2 || geometry.sizeX < 1 || geometry.sizeY < 1) {
+                printf("Invalid size %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(arg, "--threads") == 0) {
+            fluid->settings.workerThreads = atoi(value);
+        } else if (strcmp(arg, "--transport") == 0) {
+            if (strcmp(value, "step") == 0) {
+                fluid->settings.transportMode = TRANSPORT_FIXED_STEP;
+            } else if (strcmp(value, "dda") == 0) {
+                fluid->settings.transportMode = TRANSPORT_TRAVERSAL;
+            } else {
+                printf("Unknown transport mode %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(arg, "--rods") == 0) {
+            rodHeight = atof(value);
+        } else if (strcmp(arg, "--weighted") == 0) {
+            fluid->settings.weightedNeutrons = true;
+            fluid->settings.neutronPackets = atoi(value);
+        } else if (strcmp(arg, "--flux") == 0) {
+            if (strcmp(value, "auto") == 0) {
+                fluid->settings.fluxMode = FLUX_AUTO;
+            } else if (strcmp(value, "particles") == 0) {
+                fluid->settings.fluxMode = FLUX_PARTICLES;
+            } else if (strcmp(value, "continuum") == 0) {
+                fluid->settings.fluxMode = FLUX_CONTINUUM;
+            } else {
+                printf("Unknown flux mode %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(arg, "--continuum-above") == 0) {
+            fluid->settings.continuumAbove = atoi(value);
+        } else if (strcmp(arg, "--continuum-below") == 0) {
+            fluid->settings.continuumBelow = atoi(value);
+        } else if (strcmp(arg, "--fission-count") == 0) {
+            fluid->settings.fissionNeutronCount = atoi(value);
+        } else if (strcmp(arg, "--fission-speed") == 0) {
+            fluid->settings.fissionNeutronSpeed = atof(value);
+        } else if (strcmp(arg, "--fast-speed") == 0) {
+            fluid->settings.fissionFastNeutronSpeed = atof(value);
+        } else if (strcmp(arg, "--decay") == 0) {
+            fluid->settings.decayChance = atof(value);
+        } else if (strcmp(arg, "--absorption") == 0) {
+            fluid->settings.waterAbsorptionChance = atof(value);
+        } else if (strcmp(arg, "--xenon-decay") == 0) {
+            fluid->settings.xenonDecayChance = atof(value);
+        } else if (strcmp(arg, "--dissipate") == 0) {
+            fluid->settings.heatDissipate = atof(value);
+        } else if (strcmp(arg, "--heat-transfer") == 0) {
+            fluid->settings.heatTransfer = atof(value);
+        } else if (strcmp(arg, "--flow") == 0) {
+            fluid->settings.waterFlow = atof(value);
+        } else if (strcmp(arg, "--load") == 0) {
+            loadPath = value;
+        } else if (strcmp(arg, "--save") == 0) {
+            savePath = value;
+        } else if (strcmp(arg, "--telemetry") == 0) {
+            telemetryBase = value;
+        } else if (strcmp(arg, "--telemetry-format") == 0) {
+            if (strcmp(value, "csv") == 0) {
+                telemetryType = TELEMETRY_CSV;
+            } else if (strcmp(value, "bin") == 0) {
+                telemetryType = TELEMETRY_BINARY;
+            } else {
+                printf("Unknown telemetry format %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(arg, "--telemetry-every") == 0) {
+            telemetryEvery = atoi(value);
+        } else if (strcmp(arg, "--telemetry-rotate") == 0) {
+            telemetryRotate = atof(value);
+        } else if (strcmp(arg, "--events") == 0) {
+            eventPath = value;
+        } else if (strcmp(arg, "--trace") == 0) {
+            tracePath = value;
+        } else {
+            printf("Unknown option %s\n", arg);
+            PrintHelp();
+            return 1;
+        }
+    }
+
+    // Start
+    fluid->settings.seed = seed;
+    fluid->Start();
+    fluid->settings.stats.ZeroGraph();
+    if (loadPath != nullptr) {
+        // Resume exactly where the checkpoint left off
+        auto loadStart = std::chrono::steady_clock::now();
+        if (!fluid->LoadCheckpoint(loadPath)) {
+            return 1;
+        }
+        std::chrono::duration<double> loadTime = std::chrono::steady_clock::now() - loadStart;
+        geometry = fluid->geometry;
+        printf("Loaded %s in %.3f ms\n", loadPath, loadTime.count() * 1000);
+    } else {
+        fluid->SetGeometry(geometry);
+        fluid->GenerateReactor(enrichment);
+        for (int b = 0; b < fluid->RodBankCount(); b++) {
+            fluid->SetBankHeight(b, rodHeight);
+        }
+        fluid->SummonNeutrons(initialNeutrons, true);
+    }
+
+    if (telemetryBase != nullptr) {
+        if (!fluid->telemetry.Open(telemetryBase, telemetryType, telemetryEvery, telemetryRotate * 1024 * 1024)) {
+            return 1;
+        }
+    }
+
+    if (eventPath != nullptr) {
+        if (!fluid->events.Open(eventPath, geometry.sizeX, geometry.sizeY)) {
+            return 1;
+        }
+    }
+
+    // Run as fast as possible
+    profiler::SetEnabled(tracePath != nullptr);
+    auto start = std::chrono::steady_clock::now();
+    for (long t = 0; t < ticks; t++) {
+        fluid->Update();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    fluid->telemetry.Close();
+    fluid->events.Close();
+
+    // Report
+    printf("Ticks: %ld\n", ticks);
+    printf("Seed: %llu\n", (unsigned long long)seed);
+    printf("Size: %dx%d\n", geometry.sizeX, geometry.sizeY);
+    printf("Threads: %d\n", fluid->GetThreadCount());
+    printf("Transport: %s\n", fluid->settings.transportMode == TRANSPORT_TRAVERSAL ? "dda" : "step");
+    printf("Neutron model: %s\n", fluid->IsContinuum() ? "continuum" : "particles");
+    printf("Elapsed: %.3f s\n", elapsed.count());
+    printf("Ticks per second: %.1f\n", ticks / elapsed.count());
+    printf("Simulated time: %.1f s\n", ticks * NE_DELTATIME);
+    printf("Neutrons: %lld\n", (long long)fluid->neutronCount);
+    printf("Fast neutrons: %lld\n", (long long)fluid->GetFastNeutronCount());
+    if (fluid->settings.weightedNeutrons) {
+        printf("Packets: %d\n", fluid->GetPacketCount());
+    }
+    printf("Xenon: %d\n", fluid->GetXenonCount());
+    printf("Average temperature: %.2f\n", fluid->AverageReactorTemperature());
+    printf("Max temperature: %.2f\n", fluid->MaxReactorTemperature());
+    if (telemetryBase != nullptr) {
+        printf("Telemetry samples: %lld written, %lld dropped\n", fluid->telemetry.Written(), fluid->telemetry.Dropped());
+    }
+    if (eventPath != nullptr) {
+        printf("Events: %lld\n", fluid->events.Written());
+    }
+    if (savePath != nullptr && !fluid->SaveCheckpoint(savePath)) {
+        return 1;
+    }
+    if (tracePath != nullptr) {
+        if (!profiler::WriteChromeTrace(tracePath, 10)) {
+            printf("Could not write %s\n", tracePath);
+        }
+    }
+
+    delete fluid;
+    return 0;
+}